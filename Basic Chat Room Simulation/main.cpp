@@ -2,6 +2,9 @@
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <fstream>
+#include <cstdint>
+#include <filesystem>
 using namespace std;
 
 struct Message {
@@ -9,6 +12,41 @@ struct Message {
     string text;
 };
 
+// History survives restarts: every message is appended to this file as two
+// length-prefixed strings the moment it is sent.
+const string HISTORY_FILE = "chat_history.log";
+
+bool readString(ifstream& in, string& s) {
+    uint32_t len;
+    if (!in.read((char*)&len, sizeof(len)) || len > (1u << 20)) return false;   // cap guards a corrupt length
+    s.resize(len);
+    return (bool)in.read(&s[0], len);
+}
+
+void writeString(ofstream& out, const string& s) {
+    uint32_t len = (uint32_t)s.size();
+    out.write((const char*)&len, sizeof(len));
+    out.write(s.data(), len);
+}
+
+vector<Message> loadHistory() {
+    vector<Message> chat;
+    ifstream in(HISTORY_FILE, ios::binary);
+    if (!in) return chat;
+    streamoff valid = 0;
+    Message m;
+    while (readString(in, m.user) && readString(in, m.text)) {
+        chat.push_back(m);
+        valid = in.tellg();
+    }
+    in.close();
+    // Drop a record cut short by a crash so new messages are not appended after it
+    error_code ec;
+    if ((uintmax_t)valid != filesystem::file_size(HISTORY_FILE, ec) && !ec)
+        filesystem::resize_file(HISTORY_FILE, valid, ec);
+    return chat;
+}
+
 void printMenu() {
     cout << "\n--- Chat Room Simulator ---\n";
     cout << "1. Send Message\n";
@@ -18,8 +56,10 @@ void printMenu() {
 }
 
 int main() {
-    vector<Message> chat;
+    vector<Message> chat = loadHistory();
+    ofstream log(HISTORY_FILE, ios::binary | ios::app);
     int choice;
+    if (!chat.empty()) cout << "Loaded " << chat.size() << " messages from " << HISTORY_FILE << "\n";
 
     while (true) {
         printMenu();
@@ -40,6 +80,9 @@ int main() {
             getline(cin, msg.text);
 
             chat.push_back(msg);
+            writeString(log, msg.user);
+            writeString(log, msg.text);
+            log.flush();
             cout << "Message sent!\n";
         }
         else if (choice == 2) {
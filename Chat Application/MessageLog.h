@@ -0,0 +1,396 @@
+#pragma once
+// Append-only, segmented chat history (POSIX).
+// Segment files are preallocated with posix_fallocate and memory-mapped, so an
+// append is a memcpy under a mutex and never a syscall, and a full disk shows
+// up when a segment is created rather than as a fault on a sparse mapping. A background thread makes appends
+// durable with one fdatasync per interval for everything written since the
+// last one; a crash can lose that interval, while checksums let recovery stop
+// cleanly at a torn record. Since appends never change the file size,
+// fdatasync has no metadata to write.
+//
+// An in-memory index holds the positions of the last replayCount records of
+// every room, and replay reads them straight out of the mappings. Sealed
+// segments beyond the newest retainSegments are compacted in the background
+// down to the records the index still points at, and deleted once it points
+// at none of them. Once more than retainSegments compacted segments pile up,
+// the oldest is retired: its records leave the index, rooms with nothing left
+// leave it too, and the file is deleted. Disk use and the index stay bounded
+// however many rooms come and go.
+//
+// Files are named after the sequence number of their first record. Record
+// layout, in native byte order (the log never leaves the machine):
+//   u32 bodySize | u32 checksum(body) | body: u64 seq, u16 roomLen, room, frame
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct LogSegment {
+    uint64_t firstSeq = 0;
+    std::string path;
+    int fd = -1;
+    char* data = nullptr;
+    size_t capacity = 0;       // mapped bytes
+    size_t used = 0;           // bytes of complete records
+    bool compacted = false;
+
+    ~LogSegment() {
+        if (data) munmap(data, capacity);
+        if (fd >= 0) close(fd);
+    }
+};
+
+struct ReplayedMessage {
+    uint64_t seq;
+    std::shared_ptr<const std::string> frame;
+};
+
+class MessageLog {
+public:
+    static const size_t RECORD_HEADER = 8;
+
+    MessageLog(std::string dir, size_t segmentBytes, size_t replayCount, size_t retainSegments)
+        : dir(std::move(dir)), segmentBytes(segmentBytes), replayCount(replayCount),
+          retainSegments(retainSegments) {}
+
+    ~MessageLog() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (background.joinable()) background.join();
+        sync();
+    }
+
+    // Recovers existing segments and opens a fresh one to append to.
+    // Returns false with errno set if the directory or a segment cannot be used.
+    bool open() {
+        mkdir(dir.c_str(), 0755);
+        DIR* d = opendir(dir.c_str());
+        if (!d) return false;
+        std::vector<std::string> names;
+        while (dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() == 24 && name.compare(20, 4, ".log") == 0 &&
+                name.find_first_not_of("0123456789") == 20)
+                names.push_back(name);
+        }
+        closedir(d);
+        std::sort(names.begin(), names.end());
+        for (const std::string& name : names) {
+            auto seg = mapExisting(dir + "/" + name, std::stoull(name.substr(0, 20)), true);
+            if (!seg) return false;
+            if (seg->used == 0) {
+                unlink(seg->path.c_str());   // nothing survived, e.g. a segment opened just before a crash
+                continue;
+            }
+            sealed.push_back(std::move(seg));
+        }
+        tail = createSegment(nextSeq);
+        return tail != nullptr;
+    }
+
+    // Starts the background sync and compaction thread.
+    void start(std::chrono::milliseconds syncEvery) {
+        background = std::thread([this, syncEvery]() { runBackground(syncEvery); });
+    }
+
+    // Appends one frame to room's history and returns its sequence number,
+    // or 0 if the log could not take it (e.g. the disk is full).
+    uint64_t append(const std::string& room, std::string_view frame) {
+        size_t bodySize = 8 + 2 + room.size() + frame.size();
+        size_t recordSize = RECORD_HEADER + bodySize;
+        std::lock_guard<std::mutex> lock(mtx);
+        if (tail->used + recordSize > tail->capacity) {
+            auto next = createSegment(nextSeq);
+            if (!next || recordSize > next->capacity) return 0;
+            unsynced.push_back(tail);
+            sealed.push_back(std::move(tail));
+            tail = std::move(next);
+        }
+        uint64_t seq = nextSeq++;
+        char* body = tail->data + tail->used + RECORD_HEADER;
+        uint16_t roomLen = (uint16_t)room.size();
+        memcpy(body, &seq, 8);
+        memcpy(body + 8, &roomLen, 2);
+        memcpy(body + 10, room.data(), room.size());
+        memcpy(body + 10 + room.size(), frame.data(), frame.size());
+        uint32_t header[2] = {(uint32_t)bodySize, checksum(body, bodySize)};
+        memcpy(body - RECORD_HEADER, header, RECORD_HEADER);
+        remember(room, tail, tail->used, seq);
+        tail->used += recordSize;
+        dirty = true;
+        return seq;
+    }
+
+    // The last replayCount frames of room, oldest first.
+    std::vector<ReplayedMessage> replay(const std::string& room) {
+        std::deque<Position> positions;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = index.find(room);
+            if (it == index.end()) return {};
+            positions = it->second;
+        }
+        // Records below a segment's used mark never change, so the copy can run unlocked
+        std::vector<ReplayedMessage> out;
+        out.reserve(positions.size());
+        for (const Position& pos : positions) {
+            const char* rec = pos.segment->data + pos.offset;
+            uint32_t bodySize;
+            uint16_t roomLen;
+            memcpy(&bodySize, rec, 4);
+            memcpy(&roomLen, rec + RECORD_HEADER + 8, 2);
+            size_t skip = RECORD_HEADER + 10 + roomLen;
+            out.push_back({pos.seq, std::make_shared<const std::string>(rec + skip, RECORD_HEADER + bodySize - skip)});
+        }
+        return out;
+    }
+
+    size_t segments() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return sealed.size() + 1;
+    }
+
+private:
+    struct Position {
+        std::shared_ptr<LogSegment> segment;
+        size_t offset;
+        uint64_t seq;
+    };
+
+    static uint32_t checksum(const char* p, size_t n) {
+        uint32_t h = 2166136261u;   // FNV-1a
+        for (size_t i = 0; i < n; ++i) h = (h ^ (unsigned char)p[i]) * 16777619u;
+        return h;
+    }
+
+    void remember(const std::string& room, const std::shared_ptr<LogSegment>& seg, size_t offset, uint64_t seq) {
+        if (replayCount == 0) return;
+        std::deque<Position>& positions = index[room];
+        positions.push_back({seg, offset, seq});
+        if (positions.size() > replayCount) positions.pop_front();
+    }
+
+    std::string segmentPath(uint64_t firstSeq) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%020llu.log", (unsigned long long)firstSeq);
+        return dir + "/" + name;
+    }
+
+    std::shared_ptr<LogSegment> createSegment(uint64_t firstSeq) {
+        auto seg = std::make_shared<LogSegment>();
+        seg->firstSeq = firstSeq;
+        seg->path = segmentPath(firstSeq);
+        seg->fd = ::open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (seg->fd < 0) return nullptr;
+        // Real blocks, not a sparse file: a store into a hole on a full disk
+        // would be SIGBUS, and fdatasync would have allocations to record
+        int err = posix_fallocate(seg->fd, 0, segmentBytes);
+        if (err == EOPNOTSUPP || err == ENOSYS || err == EINVAL)
+            err = ftruncate(seg->fd, segmentBytes) == 0 ? 0 : errno;   // filesystem cannot reserve
+        void* p = err ? MAP_FAILED : mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+        if (p == MAP_FAILED) {
+            if (!err) err = errno;
+            unlink(seg->path.c_str());
+            errno = err;
+            return nullptr;
+        }
+        seg->data = (char*)p;
+        seg->capacity = segmentBytes;
+        return seg;
+    }
+
+    // Maps a finished segment and finds the end of its intact records. During
+    // recovery (recover = true) the records are also indexed.
+    std::shared_ptr<LogSegment> mapExisting(const std::string& path, uint64_t firstSeq, bool recover) {
+        auto seg = std::make_shared<LogSegment>();
+        seg->firstSeq = firstSeq;
+        seg->path = path;
+        seg->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (seg->fd < 0 || fstat(seg->fd, &st) != 0) return nullptr;
+        if (st.st_size == 0) return seg;
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, seg->fd, 0);
+        if (p == MAP_FAILED) return nullptr;
+        seg->data = (char*)p;
+        seg->capacity = st.st_size;
+        seg->compacted = (size_t)st.st_size < segmentBytes;
+        size_t offset = 0;
+        while (seg->capacity - offset >= RECORD_HEADER + 10) {
+            uint32_t header[2];
+            memcpy(header, seg->data + offset, RECORD_HEADER);
+            const char* body = seg->data + offset + RECORD_HEADER;
+            // Zeroes mark the unused, preallocated end; a bad checksum marks a torn write
+            if (header[0] < 10 || header[0] > seg->capacity - offset - RECORD_HEADER ||
+                checksum(body, header[0]) != header[1])
+                break;
+            uint64_t seq;
+            uint16_t roomLen;
+            memcpy(&seq, body, 8);
+            memcpy(&roomLen, body + 8, 2);
+            if (10u + roomLen > header[0]) break;
+            if (recover) {
+                remember(std::string(body + 10, roomLen), seg, offset, seq);
+                nextSeq = std::max(nextSeq, seq + 1);
+            }
+            offset += RECORD_HEADER + header[0];
+        }
+        seg->used = offset;
+        return seg;
+    }
+
+    void runBackground(std::chrono::milliseconds syncEvery) {
+        auto lastCompaction = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stopping) {
+            wake.wait_for(lock, syncEvery);
+            lock.unlock();
+            sync();
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastCompaction >= std::chrono::seconds(1)) {
+                while (compactOnce()) {}
+                lastCompaction = now;
+            }
+            lock.lock();
+        }
+    }
+
+    // One fdatasync per segment written to since the last call.
+    void sync() {
+        std::vector<std::shared_ptr<LogSegment>> toSync;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!dirty) return;
+            toSync.swap(unsynced);
+            toSync.push_back(tail);
+            dirty = false;
+        }
+        for (const auto& seg : toSync) fdatasync(seg->fd);
+    }
+
+    // Compacts, deletes or retires the oldest sealed segment past the
+    // retention limits. Returns true if there may be more to do.
+    bool compactOnce() {
+        std::shared_ptr<LogSegment> victim;
+        std::vector<size_t> keep;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t fresh = 0;
+            for (const auto& seg : sealed) fresh += !seg->compacted;
+            if (sealed.size() - fresh > retainSegments) {
+                for (const auto& seg : sealed) {
+                    if (seg->compacted) {
+                        retire(seg);
+                        return true;
+                    }
+                }
+            }
+            for (const auto& seg : sealed) {
+                if (seg->compacted ? referencedBy(seg).empty() : fresh > retainSegments) {
+                    victim = seg;
+                    break;
+                }
+            }
+            if (!victim) return false;
+            keep = referencedBy(victim);
+            if (keep.empty()) {
+                retire(victim);
+                return true;
+            }
+        }
+
+        // Sealed segments are immutable, so the copy needs no lock
+        std::string tmpPath = victim->path + ".compact";
+        int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        std::unordered_map<size_t, size_t> moved;
+        std::string out;
+        for (size_t offset : keep) {
+            uint32_t bodySize;
+            memcpy(&bodySize, victim->data + offset, 4);
+            moved[offset] = out.size();
+            out.append(victim->data + offset, RECORD_HEADER + bodySize);
+        }
+        bool ok = write(fd, out.data(), out.size()) == (ssize_t)out.size() && fdatasync(fd) == 0;
+        close(fd);
+        std::shared_ptr<LogSegment> compacted;
+        if (ok && rename(tmpPath.c_str(), victim->path.c_str()) == 0)
+            compacted = mapExisting(victim->path, victim->firstSeq, false);
+        if (!compacted) {
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        compacted->compacted = true;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        // The index can only have dropped positions in victim since keep was taken
+        for (auto& room : index) {
+            for (Position& pos : room.second) {
+                if (pos.segment != victim) continue;
+                pos.segment = compacted;
+                pos.offset = moved[pos.offset];
+            }
+        }
+        *std::find(sealed.begin(), sealed.end(), victim) = compacted;
+        return true;
+    }
+
+    // Drops seg's records from the index, and rooms left without any, then
+    // deletes seg. Readers still holding it keep the mapping alive. Requires mtx.
+    void retire(std::shared_ptr<LogSegment> seg) {
+        for (auto it = index.begin(); it != index.end();) {
+            std::deque<Position>& positions = it->second;
+            positions.erase(std::remove_if(positions.begin(), positions.end(),
+                                           [&](const Position& pos) { return pos.segment == seg; }),
+                            positions.end());
+            if (positions.empty()) it = index.erase(it);
+            else ++it;
+        }
+        unlink(seg->path.c_str());
+        sealed.erase(std::find(sealed.begin(), sealed.end(), seg));
+    }
+
+    // Offsets of the indexed records in seg, ascending. Requires mtx.
+    std::vector<size_t> referencedBy(const std::shared_ptr<LogSegment>& seg) const {
+        std::vector<size_t> offsets;
+        for (const auto& room : index)
+            for (const Position& pos : room.second)
+                if (pos.segment == seg) offsets.push_back(pos.offset);
+        std::sort(offsets.begin(), offsets.end());
+        return offsets;
+    }
+
+    std::string dir;
+    size_t segmentBytes;
+    size_t replayCount;
+    size_t retainSegments;
+    std::mutex mtx;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool dirty = false;
+    uint64_t nextSeq = 1;
+    std::shared_ptr<LogSegment> tail;
+    std::vector<std::shared_ptr<LogSegment>> sealed;     // oldest first
+    std::vector<std::shared_ptr<LogSegment>> unsynced;   // sealed since the last sync
+    std::unordered_map<std::string, std::deque<Position>> index;
+    std::thread background;
+};
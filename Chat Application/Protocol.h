@@ -0,0 +1,89 @@
+#pragma once
+// Wire format shared by the chat server and client.
+// Every message is a frame: a 4-byte big-endian payload length, a 1-byte
+// message type, then the payload. Framing keeps message boundaries intact no
+// matter how TCP splits or merges the bytes, and lets a reader pull many
+// frames out of one recv.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class MsgType : uint8_t {
+    Chat = 1,     // text from a user; relayed to the rest of the sender's room
+    Notice = 2,   // text generated by the server (joins, leaves)
+    Join = 3,     // client asks to move to the room named by the payload
+};
+
+const size_t FRAME_HEADER_SIZE = 5;
+const size_t MAX_FRAME_PAYLOAD = 64 * 1024;
+
+// Appends one encoded frame to out.
+inline void appendFrame(std::string& out, MsgType type, std::string_view payload) {
+    uint32_t len = (uint32_t)payload.size();
+    char header[FRAME_HEADER_SIZE] = {(char)(len >> 24), (char)(len >> 16), (char)(len >> 8), (char)len,
+                                      (char)type};
+    out.append(header, FRAME_HEADER_SIZE);
+    out.append(payload);
+}
+
+inline std::string encodeFrame(MsgType type, std::string_view payload) {
+    std::string out;
+    out.reserve(FRAME_HEADER_SIZE + payload.size());
+    appendFrame(out, type, payload);
+    return out;
+}
+
+struct Frame {
+    MsgType type;
+    std::string_view payload;   // points into the reader's buffer; valid until the next read
+    std::string_view raw;       // header and payload, for relaying the frame unchanged
+};
+
+enum class FrameStatus { Incomplete, Complete, Error };
+
+// Incremental frame decoder over one reusable buffer. Received bytes go
+// straight into space(), and next() hands out complete frames in place, so a
+// steady stream of messages costs no allocation per frame.
+class FrameReader {
+public:
+    FrameReader() : buf(16 * 1024) {}
+
+    // Writable space for at least want more bytes; report what was filled with
+    // commit(). Call before spaceLeft(), since it may grow or compact the buffer.
+    char* space(size_t want) {
+        if (start > 0 && (start == end || buf.size() - end < want)) {
+            memmove(buf.data(), buf.data() + start, end - start);   // slide the partial frame down
+            end -= start;
+            start = 0;
+        }
+        if (buf.size() - end < want) buf.resize(end + want);
+        return buf.data() + end;
+    }
+
+    size_t spaceLeft() const { return buf.size() - end; }
+
+    void commit(size_t n) { end += n; }
+
+    // Error means the peer announced a frame larger than MAX_FRAME_PAYLOAD.
+    FrameStatus next(Frame& frame) {
+        size_t avail = end - start;
+        if (avail < FRAME_HEADER_SIZE) return FrameStatus::Incomplete;
+        const unsigned char* p = (const unsigned char*)buf.data() + start;
+        size_t len = (size_t)p[0] << 24 | (size_t)p[1] << 16 | (size_t)p[2] << 8 | p[3];
+        if (len > MAX_FRAME_PAYLOAD) return FrameStatus::Error;
+        if (avail < FRAME_HEADER_SIZE + len) return FrameStatus::Incomplete;
+        frame.type = (MsgType)p[4];
+        frame.raw = std::string_view(buf.data() + start, FRAME_HEADER_SIZE + len);
+        frame.payload = frame.raw.substr(FRAME_HEADER_SIZE);
+        start += FRAME_HEADER_SIZE + len;
+        return FrameStatus::Complete;
+    }
+
+private:
+    std::vector<char> buf;
+    size_t start = 0;   // first unconsumed byte
+    size_t end = 0;     // one past the last received byte
+};
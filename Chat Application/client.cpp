@@ -1,7 +1,24 @@
+// client.cpp - chat client
+//
+// Usage: client           interactive: prompts for the server IP, then sends every
+//                         input line (/join <room> switches rooms)
+//        client --swarm [--host=IP] [--port=N] [--clients=N] [--threads=N] [--rooms=N]
+//                       [--rate=MSGS_PER_SEC] [--size=BYTES] [--duration=SECONDS]
+//
+// --swarm (Linux) is a headless load generator: one process opens thousands of
+// simulated clients over epoll, spreads them across rooms swarm-0..N-1, and has
+// each one send --rate messages per second. Every message carries its send
+// time, so each delivery to another simulated client yields an end-to-end
+// fan-out latency. Sender and receiver share this process's steady clock, so
+// the numbers need no clock sync but only make sense against one server.
+
 #include <iostream>
 #include <thread>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include "Protocol.h"
 #ifdef _WIN32
 #include <winsock2.h>
 #pragma comment(lib, "ws2_32.lib")
@@ -12,20 +29,373 @@
 #define INVALID_SOCKET -1
 #define SOCKET int
 #endif
+#ifdef __linux__
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
 void recvThread(SOCKET sock) {
-    char buffer[512];
-    while (true) {
-        int len = recv(sock, buffer, sizeof(buffer)-1, 0);
+    FrameReader in;
+    Frame frame;
+    FrameStatus status = FrameStatus::Incomplete;
+    while (status != FrameStatus::Error) {
+        char* dst = in.space(4096);
+        int len = recv(sock, dst, (int)in.spaceLeft(), 0);
         if (len <= 0) break;
-        buffer[len] = 0;
-        cout << buffer << endl;
+        in.commit(len);
+        while ((status = in.next(frame)) == FrameStatus::Complete) {
+            if (frame.type == MsgType::Notice) cout << "* " << frame.payload << endl;
+            else cout << frame.payload << endl;
+        }
+    }
+}
+
+bool sendAll(SOCKET sock, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(sock, data.data() + sent, (int)(data.size() - sent), 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+#ifdef __linux__
+// --- Headless swarm mode ---
+
+using Clock = chrono::steady_clock;
+
+struct SwarmConfig {
+    string host = "127.0.0.1";
+    int port = 9009;
+    int clients = 1000;
+    int threads = 1;
+    int rooms = 1;
+    double rate = 1.0;           // messages per second per simulated client
+    size_t size = 64;            // chat payload bytes, including the stamp
+    int durationSeconds = 10;
+};
+
+// Payload stamp: magic, send time in steady_clock nanoseconds, sender id.
+const char SWARM_MAGIC[4] = {'S', 'W', 'R', 'M'};
+const size_t SWARM_STAMP_SIZE = 4 + 8 + 4;
+
+// Log-linear histogram over nanoseconds: 16 sub-buckets per power of two
+// (about 6% relative error) in a fixed array, so millions of deliveries cost
+// no memory and per-thread histograms merge by addition.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    void record(uint64_t v) {
+        counts[bucketFor(v)]++;
+        total++;
+        if (v > maxValue) maxValue = v;
+    }
+
+    void merge(const LatencyHistogram& o) {
+        for (int i = 0; i < BUCKETS; i++) counts[i] += o.counts[i];
+        total += o.total;
+        maxValue = max(maxValue, o.maxValue);
+    }
+
+    // Upper bound of the bucket holding quantile q.
+    uint64_t quantile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (total - 1)) + 1, seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return min(bucketUpper(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t maxRecorded() const { return maxValue; }
+
+private:
+    static int bucketFor(uint64_t v) {
+        if (v < (uint64_t)SUB) return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        return (msb - SUB_BITS + 1) * SUB + (int)((v >> (msb - SUB_BITS)) & (SUB - 1));
+    }
+
+    static uint64_t bucketUpper(int b) {
+        if (b < SUB) return b;
+        int shift = b / SUB - 1;
+        return (((uint64_t)(SUB + b % SUB) + 1) << shift) - 1;
+    }
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t maxValue = 0;
+};
+
+struct SimClient {
+    int fd = -1;
+    uint32_t id = 0;
+    int room = 0;
+    string out;                  // frames not yet accepted by the socket
+    size_t outSent = 0;
+    FrameReader in;
+};
+
+struct SwarmStats {
+    unsigned long long sent = 0, delivered = 0, errors = 0;
+    vector<unsigned long long> sentPerRoom;
+    LatencyHistogram latency;
+};
+
+class SwarmWorker {
+public:
+    SwarmWorker(const SwarmConfig& cfg, int first, int count) : cfg(cfg), first(first), count(count) {
+        stats.sentPerRoom.assign(cfg.rooms, 0);
+    }
+
+    SwarmStats stats;
+
+    // Connects every client, joins its room, then sends on schedule between
+    // sendStart and sendEnd and keeps reading until drainEnd so messages
+    // still in flight are counted.
+    void run(Clock::time_point sendStart, Clock::time_point sendEnd, Clock::time_point drainEnd,
+             atomic<int>& connected) {
+        ep = epoll_create1(0);
+        if (ep < 0) { perror("epoll_create1"); return; }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(cfg.port);
+        inet_pton(AF_INET, cfg.host.c_str(), &addr.sin_addr);
+
+        clients.resize(count);
+        for (int i = 0; i < count; i++) {
+            SimClient& c = clients[i];
+            c.id = (uint32_t)(first + i);
+            c.room = (int)(c.id % cfg.rooms);
+            c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (c.fd < 0) { stats.errors++; continue; }
+            int one = 1;
+            setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connect(c.fd, (sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+                stats.errors++;
+                close(c.fd);
+                c.fd = -1;
+                continue;
+            }
+            appendFrame(c.out, MsgType::Join, "swarm-" + to_string(c.room));
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+            ev.data.u32 = (uint32_t)i;
+            epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+            connected++;
+        }
+
+        // Each client gets a random phase within its send interval so the
+        // swarm does not send in lockstep.
+        auto interval = chrono::nanoseconds((long long)(1e9 / cfg.rate));
+        using Due = pair<Clock::time_point, int>;
+        priority_queue<Due, vector<Due>, greater<Due>> schedule;
+        for (int i = 0; i < count; i++)
+            if (clients[i].fd >= 0)
+                schedule.push({sendStart + chrono::nanoseconds(rand() % max<long long>(1, interval.count())), i});
+
+        string payload(max(cfg.size, SWARM_STAMP_SIZE), 'x');
+        memcpy(&payload[0], SWARM_MAGIC, 4);
+        measureFrom = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(sendStart.time_since_epoch()).count();
+
+        epoll_event events[256];
+        for (;;) {
+            Clock::time_point now = Clock::now();
+            if (now >= drainEnd) break;
+            while (now < sendEnd && !schedule.empty() && schedule.top().first <= now) {
+                auto [due, i] = schedule.top();
+                schedule.pop();
+                SimClient& c = clients[i];
+                if (c.fd < 0) continue;
+                uint64_t stamp = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+                memcpy(&payload[4], &stamp, 8);
+                memcpy(&payload[12], &c.id, 4);
+                appendFrame(c.out, MsgType::Chat, payload);
+                stats.sent++;
+                stats.sentPerRoom[c.room]++;
+                flush(i);
+                // Keep to the fixed schedule, but a client that fell far behind
+                // restarts from now instead of bursting to catch up.
+                due += interval;
+                if (now - due > chrono::seconds(1)) due = now + interval;
+                schedule.push({due, i});
+            }
+
+            int timeout = 10;
+            if (now < sendEnd && !schedule.empty()) {
+                auto wait = chrono::duration_cast<chrono::milliseconds>(schedule.top().first - now).count();
+                timeout = (int)max<long long>(0, min<long long>(wait, 10));
+            }
+            int n = epoll_wait(ep, events, 256, timeout);
+            for (int e = 0; e < n; e++) {
+                int i = (int)events[e].data.u32;
+                if (clients[i].fd < 0) continue;
+                if (events[e].events & (EPOLLERR | EPOLLHUP)) { fail(i); continue; }
+                if (events[e].events & EPOLLIN) readFrames(i);
+                if (clients[i].fd >= 0 && (events[e].events & EPOLLOUT)) flush(i);
+            }
+        }
+        for (SimClient& c : clients)
+            if (c.fd >= 0) close(c.fd);
+        close(ep);
+    }
+
+private:
+    void fail(int i) {
+        stats.errors++;
+        close(clients[i].fd);
+        clients[i].fd = -1;
+    }
+
+    void flush(int i) {
+        SimClient& c = clients[i];
+        while (c.outSent < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN) fail(i);
+                return;   // EPOLLOUT resumes once the socket drains or finishes connecting
+            }
+            c.outSent += n;
+        }
+        c.out.clear();
+        c.outSent = 0;
+    }
+
+    void readFrames(int i) {
+        SimClient& c = clients[i];
+        for (;;) {
+            char* dst = c.in.space(16 * 1024);
+            ssize_t len = recv(c.fd, dst, c.in.spaceLeft(), 0);
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (len <= 0) { fail(i); return; }
+            c.in.commit(len);
+            uint64_t now = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+            Frame frame;
+            FrameStatus status;
+            while ((status = c.in.next(frame)) == FrameStatus::Complete) {
+                if (frame.type != MsgType::Chat || frame.payload.size() < SWARM_STAMP_SIZE ||
+                    memcmp(frame.payload.data(), SWARM_MAGIC, 4) != 0)
+                    continue;
+                uint64_t stamp;
+                memcpy(&stamp, frame.payload.data() + 4, 8);
+                if (stamp < measureFrom) continue;
+                stats.delivered++;
+                stats.latency.record(now > stamp ? now - stamp : 0);
+            }
+            if (status == FrameStatus::Error) { fail(i); return; }
+        }
+    }
+
+    const SwarmConfig& cfg;
+    int first, count;
+    int ep = -1;
+    uint64_t measureFrom = 0;
+    vector<SimClient> clients;
+};
+
+int runSwarm(int argc, char* argv[]) {
+    SwarmConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--swarm") continue;
+        if (arg.rfind("--host=", 0) == 0) cfg.host = arg.substr(7);
+        else if (arg.rfind("--port=", 0) == 0) cfg.port = atoi(arg.c_str() + 7);
+        else if (arg.rfind("--clients=", 0) == 0) cfg.clients = max(2, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--threads=", 0) == 0) cfg.threads = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--rooms=", 0) == 0) cfg.rooms = max(1, atoi(arg.c_str() + 8));
+        else if (arg.rfind("--rate=", 0) == 0) cfg.rate = max(0.01, atof(arg.c_str() + 7));
+        else if (arg.rfind("--size=", 0) == 0) cfg.size = min((size_t)max(0, atoi(arg.c_str() + 7)), MAX_FRAME_PAYLOAD);
+        else if (arg.rfind("--duration=", 0) == 0) cfg.durationSeconds = max(1, atoi(arg.c_str() + 11));
+        else {
+            cerr << "Usage: " << argv[0] << " --swarm [--host=IP] [--port=N] [--clients=N] [--threads=N]"
+                 << " [--rooms=N] [--rate=MSGS_PER_SEC] [--size=BYTES] [--duration=SECONDS]\n";
+            return 1;
+        }
     }
+    cfg.threads = min(cfg.threads, cfg.clients);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Thousands of sockets need more than the usual 1024 descriptors.
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // Leave time for every client to connect and join before the first send,
+    // so join notices and handshakes do not skew the measured window.
+    auto sendStart = Clock::now() + chrono::milliseconds(500 + cfg.clients / 2);
+    auto sendEnd = sendStart + chrono::seconds(cfg.durationSeconds);
+    auto drainEnd = sendEnd + chrono::seconds(1);
+
+    atomic<int> connected{0};
+    vector<unique_ptr<SwarmWorker>> workers;
+    vector<thread> threads;
+    for (int t = 0; t < cfg.threads; t++) {
+        int first = (int)((long long)cfg.clients * t / cfg.threads);
+        int last = (int)((long long)cfg.clients * (t + 1) / cfg.threads);
+        workers.push_back(make_unique<SwarmWorker>(cfg, first, last - first));
+    }
+    for (auto& w : workers) threads.emplace_back([&, w = w.get()] { w->run(sendStart, sendEnd, drainEnd, connected); });
+    for (auto& t : threads) t.join();
+
+    SwarmStats total;
+    total.sentPerRoom.assign(cfg.rooms, 0);
+    for (auto& w : workers) {
+        total.sent += w->stats.sent;
+        total.delivered += w->stats.delivered;
+        total.errors += w->stats.errors;
+        for (int r = 0; r < cfg.rooms; r++) total.sentPerRoom[r] += w->stats.sentPerRoom[r];
+        total.latency.merge(w->stats.latency);
+    }
+    // Every message should reach the other members of its room.
+    unsigned long long expected = 0;
+    for (int r = 0; r < cfg.rooms; r++) {
+        long long members = cfg.clients / cfg.rooms + (r < cfg.clients % cfg.rooms ? 1 : 0);
+        expected += total.sentPerRoom[r] * (unsigned long long)max(0LL, members - 1);
+    }
+
+    auto ms = [](uint64_t ns) { return ns / 1e6; };
+    printf("%7s %5s %6s %9s %11s %11s %7s %11s %8s %8s %8s %8s %6s\n", "clients", "rooms", "rate", "sent",
+           "delivered", "expected", "ratio", "deliv/s", "p50 ms", "p99 ms", "p999 ms", "max ms", "errors");
+    printf("%7d %5d %6.1f %9llu %11llu %11llu %6.1f%% %11.0f %8.3f %8.3f %8.3f %8.3f %6llu\n", connected.load(),
+           cfg.rooms, cfg.rate, total.sent, total.delivered, expected,
+           expected ? 100.0 * total.delivered / expected : 0.0, total.delivered / (double)cfg.durationSeconds,
+           ms(total.latency.quantile(0.50)), ms(total.latency.quantile(0.99)), ms(total.latency.quantile(0.999)),
+           ms(total.latency.maxRecorded()), total.errors);
+    return 0;
 }
+#endif
 
-int main() {
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) != "--swarm") continue;
+#ifdef __linux__
+        return runSwarm(argc, argv);
+#else
+        cerr << "--swarm needs Linux (epoll)\n";
+        return 1;
+#endif
+    }
 #ifdef _WIN32
     WSADATA wsa; WSAStartup(MAKEWORD(2,2), &wsa);
 #endif
@@ -43,12 +413,15 @@ int main() {
         cerr << "Connection failed\n";
         return 1;
     }
-    cout << "Connected. You can start typing messages.\n";
+    cout << "Connected. You can start typing messages (/join <room> to switch rooms).\n";
 
     thread t(recvThread, sock);
     string msg;
     while (getline(cin, msg)) {
-        send(sock, msg.c_str(), msg.size(), 0);
+        if (msg.size() > MAX_FRAME_PAYLOAD) msg.resize(MAX_FRAME_PAYLOAD);
+        bool join = msg.rfind("/join ", 0) == 0;
+        string frame = join ? encodeFrame(MsgType::Join, msg.substr(6)) : encodeFrame(MsgType::Chat, msg);
+        if (!sendAll(sock, frame)) break;
     }
 #ifdef _WIN32
     closesocket(sock); WSACleanup();
@@ -1,9 +1,36 @@
+// Chat server.
+// Usage: server [--port=N] [--workers=N] [--queue-messages=N] [--queue-bytes=N]
+//               [--slow-policy=drop|disconnect] [--history-dir=DIR] [--replay=N]
+//               [--segment-mb=N] [--retain-segments=N] [--sync-ms=N]
+//
+// Messages travel as length-prefixed frames (see Protocol.h). Every client
+// is in one named room at a time ("lobby" on connect) and switches with a
+// Join frame; chat is relayed to the other members of the sender's room.
+//
+// On Linux the server runs one epoll loop per worker thread, each owning the
+// connections it accepted. A frame is queued on each recipient's bounded
+// outbound ring (members on other workers are reached through that worker's
+// inbox), and every ring touched during a loop iteration is flushed with a
+// single writev, so a burst of frames costs one syscall per recipient and a
+// slow reader never stalls the sender or the rest of the room. When a
+// client's ring is full the slow-consumer policy applies: drop that client's
+// oldest queued messages, or disconnect it.
+// With --history-dir, chat is also appended to a segmented on-disk log (see
+// MessageLog.h) and a client joining a room first gets its last --replay
+// messages.
+// Other platforms keep the thread-per-client server, without history.
+
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <string>
 #include <cstring>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include "Protocol.h"
 #ifdef _WIN32
 #include <winsock2.h>
 #pragma comment(lib, "ws2_32.lib")
@@ -15,66 +42,639 @@ typedef int socklen_t;
 #define INVALID_SOCKET -1
 #define SOCKET int
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <csignal>
+#include <cerrno>
+#include "MessageLog.h"
+#endif
 
 using namespace std;
 
-vector<SOCKET> clients;
+enum class SlowPolicy { DropOldest, Disconnect };
+
+size_t queueMessages = 1024;
+size_t queueBytes = 1 << 20;
+SlowPolicy slowPolicy = SlowPolicy::DropOldest;
+
+void closeSocket(SOCKET s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+#ifdef __linux__
+// Bounded FIFO of messages waiting to go out to one client. Payloads are
+// shared by every recipient of a broadcast, so fan-out copies a pointer.
+class OutboundRing {
+public:
+    OutboundRing(size_t maxMessages, size_t maxBytes) : slots(maxMessages), maxBytes(maxBytes) {}
+
+    bool empty() const { return count == 0; }
+    size_t freeSlots() const { return slots.size() - count; }
+    size_t freeBytes() const { return maxBytes - bytes; }
+
+    // Appends msg unless that would exceed either bound.
+    bool push(shared_ptr<const string> msg) {
+        if (count == slots.size() || bytes + msg->size() > maxBytes) return false;
+        bytes += msg->size();
+        slots[(head + count++) % slots.size()] = move(msg);
+        return true;
+    }
+
+    // Discards the oldest message that has not started going out. A partly
+    // written message has to finish or the peer would see a torn message.
+    bool dropOldest() {
+        if (frontSent == 0) {
+            if (count == 0) return false;
+            popFront();
+            return true;
+        }
+        if (count < 2) return false;
+        size_t second = (head + 1) % slots.size();
+        bytes -= slots[second]->size();
+        slots[second] = move(slots[head]);
+        head = second;
+        count--;
+        return true;
+    }
+
+    // Points iov at the unsent bytes of up to max queued messages.
+    int fill(iovec* iov, int max) const {
+        int n = 0;
+        for (size_t i = 0; i < count && n < max; ++i, ++n) {
+            const string& msg = *slots[(head + i) % slots.size()];
+            size_t skip = i == 0 ? frontSent : 0;
+            iov[n].iov_base = (void*)(msg.data() + skip);
+            iov[n].iov_len = msg.size() - skip;
+        }
+        return n;
+    }
+
+    // Marks n bytes as written.
+    void consume(size_t n) {
+        while (n > 0) {
+            size_t left = slots[head]->size() - frontSent;
+            if (n < left) {
+                frontSent += n;
+                return;
+            }
+            n -= left;
+            popFront();
+        }
+    }
+
+private:
+    void popFront() {
+        bytes -= slots[head]->size();
+        slots[head].reset();
+        head = (head + 1) % slots.size();
+        count--;
+        frontSent = 0;
+    }
+
+    vector<shared_ptr<const string>> slots;
+    size_t maxBytes;
+    size_t head = 0, count = 0, bytes = 0;
+    size_t frontSent = 0;   // bytes of the front message already written
+};
+
+class Worker;
+struct Room;
+struct Members;
+
+struct Client {
+    int fd;
+    unsigned long long id;
+    Worker* owner;                // the only thread that touches the fields below
+    size_t index;                 // position in owner's clients
+    FrameReader in;
+    OutboundRing out{queueMessages, queueBytes};
+    shared_ptr<Room> room;
+    shared_ptr<const Members> members;   // cached snapshot of room's membership
+    uint64_t membersVersion = 0;
+    uint64_t replayedThrough = 0;  // newest history seq already replayed into out
+    bool wantWrite = false;       // EPOLLOUT is registered
+    bool dirty = false;           // on the flush list for this iteration
+    bool closed = false;
+    unsigned long long dropped = 0;
+};
+
+// Members of a room, grouped by the worker that owns each connection so a
+// broadcast hands every other worker its share in one step.
+struct MemberGroup {
+    Worker* worker;
+    vector<shared_ptr<Client>> clients;
+};
+
+struct Members {
+    vector<MemberGroup> groups;
+};
+
+// A room's membership is an immutable snapshot that joins and leaves replace
+// wholesale (copy-on-write). Broadcasters cache the snapshot and re-read it
+// only when version moves, so a broadcast to an unchanged room costs one
+// atomic load and never waits for, or blocks, a join or leave in progress.
+// The re-read is std::atomic_load on the shared_ptr, which libstdc++ guards
+// with a small internal spinlock held only while the pointer is copied; it is
+// not lock-free. Old snapshots live as long as a broadcast still holds them.
+struct Room {
+    string name;
+    shared_ptr<const Members> members = make_shared<const Members>();
+    atomic<uint64_t> version{1};
+};
+
+// Name -> room map. The locks serialize membership changes only; shards keep
+// joins to different rooms from contending.
+class RoomRegistry {
+public:
+    static const size_t SHARDS = 16;
+
+    shared_ptr<Room> join(const string& name, const shared_ptr<Client>& client) {
+        Shard& shard = shardFor(name);
+        lock_guard<mutex> lock(shard.mtx);
+        shared_ptr<Room>& room = shard.rooms[name];
+        if (!room) {
+            room = make_shared<Room>();
+            room->name = name;
+        }
+        auto next = make_shared<Members>(*atomic_load(&room->members));
+        auto group = find_if(next->groups.begin(), next->groups.end(),
+                             [&](const MemberGroup& g) { return g.worker == client->owner; });
+        if (group == next->groups.end()) group = next->groups.insert(group, MemberGroup{client->owner, {}});
+        group->clients.push_back(client);
+        publish(*room, move(next));
+        return room;
+    }
+
+    void leave(const shared_ptr<Room>& room, const Client* client) {
+        Shard& shard = shardFor(room->name);
+        lock_guard<mutex> lock(shard.mtx);
+        auto next = make_shared<Members>(*atomic_load(&room->members));
+        for (auto g = next->groups.begin(); g != next->groups.end(); ++g) {
+            if (g->worker != client->owner) continue;
+            g->clients.erase(remove_if(g->clients.begin(), g->clients.end(),
+                                       [&](const shared_ptr<Client>& c) { return c.get() == client; }),
+                             g->clients.end());
+            if (g->clients.empty()) next->groups.erase(g);
+            break;
+        }
+        bool empty = next->groups.empty();
+        publish(*room, move(next));
+        auto it = shard.rooms.find(room->name);
+        if (empty && it != shard.rooms.end() && it->second == room) shard.rooms.erase(it);
+    }
+
+private:
+    struct Shard {
+        mutex mtx;
+        unordered_map<string, shared_ptr<Room>> rooms;
+    };
+
+    static void publish(Room& room, shared_ptr<const Members> next) {
+        atomic_store(&room.members, move(next));
+        room.version.fetch_add(1, memory_order_release);
+    }
+
+    Shard& shardFor(const string& name) { return shards[hash<string>()(name) % SHARDS]; }
+
+    Shard shards[SHARDS];
+};
+
+// One message for the members of a room that live on another worker. It holds
+// the room so a queued delivery can never match a newer room that happens to
+// be allocated at the same address.
+struct Delivery {
+    shared_ptr<const string> msg;
+    shared_ptr<Room> room;
+    shared_ptr<const Members> members;
+    size_t group;
+    const Client* exclude;
+    uint64_t seq;
+    Delivery* next = nullptr;
+};
+
+const size_t MAX_ROOM_NAME = 64;
+atomic<unsigned long long> nextClientId{1};
+unique_ptr<MessageLog> history;   // null unless --history-dir was given
+
+int setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// One epoll loop per thread. Workers share the listening socket and each owns
+// the connections it accepts; fan-out to another worker's connections goes
+// through that worker's inbox.
+class Worker {
+public:
+    Worker(int listenFd, RoomRegistry& rooms)
+        : listenFd(listenFd), rooms(rooms), epfd(epoll_create1(EPOLL_CLOEXEC)),
+          wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;   // wake one worker per incoming connection
+        ev.data.ptr = nullptr;                  // the listener is the only event without an owner
+        epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.ptr = this;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+
+    // Callable from any thread. Lock-free push; the owner is only woken when
+    // its inbox goes from empty to non-empty, so a burst costs one wakeup.
+    void post(Delivery* d) {
+        // d belongs to the owner as soon as the exchange succeeds, so test the old head, not d->next
+        Delivery* head = inbox.load(memory_order_relaxed);
+        do {
+            d->next = head;
+        } while (!inbox.compare_exchange_weak(head, d, memory_order_release, memory_order_relaxed));
+        if (!head) {
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    void run() {
+        epoll_event events[256];
+        while (true) {
+            int n = epoll_wait(epfd, events, 256, closedList.empty() ? -1 : 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                void* ptr = events[i].data.ptr;
+                if (!ptr) {
+                    acceptAll();
+                    continue;
+                }
+                if (ptr == this) {
+                    uint64_t count;
+                    ssize_t ignored = read(wakeFd, &count, sizeof(count));
+                    (void)ignored;
+                    drainInbox();
+                    continue;
+                }
+                Client* c = (Client*)ptr;
+                if (!c->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) onReadable(c);
+                if (!c->closed && (events[i].events & EPOLLOUT)) flush(c);
+            }
+            // Leave notices can disconnect more slow clients, which appends to the list
+            for (size_t i = 0; i < closedList.size(); ++i) leaveRoom(closedList[i].get());
+            size_t announced = closedList.size();
+            // Everything queued while handling this batch goes out with one writev per client
+            for (Client* c : dirtyList) {
+                c->dirty = false;
+                if (!c->closed && !c->wantWrite) flush(c);
+            }
+            dirtyList.clear();
+            // Clients whose flush failed are announced (and released) on the next pass
+            closedList.erase(closedList.begin(), closedList.begin() + announced);
+        }
+    }
+
+private:
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            auto c = make_shared<Client>();
+            c->fd = fd;
+            c->id = nextClientId.fetch_add(1, memory_order_relaxed);
+            c->owner = this;
+            c->index = clients.size();
+            clients.push_back(c);
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = c.get();
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+            joinRoom(c, "lobby");
+        }
+    }
+
+    void onReadable(Client* c) {
+        char* dst = c->in.space(16 * 1024);   // before spaceLeft(), which it can change
+        ssize_t len = recv(c->fd, dst, c->in.spaceLeft(), 0);
+        if (len < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        if (len <= 0) {
+            closeClient(c);
+            return;
+        }
+        c->in.commit(len);
+        Frame frame;
+        FrameStatus status = FrameStatus::Incomplete;
+        while (!c->closed && (status = c->in.next(frame)) == FrameStatus::Complete) {
+            if (frame.type == MsgType::Chat) {
+                // Logged first so a concurrent joiner finds it in either the replay or the broadcast
+                uint64_t seq = history ? history->append(c->room->name, frame.raw) : 0;
+                // Relayed byte for byte to the sender's room
+                broadcast(c->room, currentMembers(c), make_shared<const string>(frame.raw), c, seq);
+            } else if (frame.type == MsgType::Join) {
+                string name(frame.payload);
+                if (name.empty() || name.size() > MAX_ROOM_NAME || name == c->room->name) continue;
+                leaveRoom(c);
+                joinRoom(clients[c->index], name);
+            }
+            // Clients may not send notices; other types are ignored
+        }
+        if (!c->closed && status == FrameStatus::Error) closeClient(c);
+    }
+
+    const shared_ptr<const Members>& currentMembers(Client* c) {
+        uint64_t version = c->room->version.load(memory_order_acquire);
+        if (version != c->membersVersion) {
+            c->members = atomic_load(&c->room->members);
+            c->membersVersion = version;
+        }
+        return c->members;
+    }
+
+    // Takes its own reference: a replay that trips the slow-client policy
+    // closes c, which moves entries of clients around.
+    void joinRoom(shared_ptr<Client> c, const string& name) {
+        c->room = rooms.join(name, c);
+        c->replayedThrough = 0;
+        auto joined = make_shared<const string>(
+            encodeFrame(MsgType::Notice, "user " + to_string(c->id) + " joined #" + name));
+        if (history) {
+            // Anything logged after this read reaches c live; older broadcasts are skipped
+            vector<ReplayedMessage> backlog = history->replay(name);
+            if (!backlog.empty()) c->replayedThrough = backlog.back().seq;
+            // Only the newest messages that fit in c's ring beside the join
+            // notice are replayed, so a long history alone never overflows it
+            size_t first = backlog.size(), slots = c->out.freeSlots(), bytes = c->out.freeBytes();
+            if (slots > 0 && bytes >= joined->size()) {
+                slots--;
+                bytes -= joined->size();
+                while (first > 0 && slots > 0 && backlog[first - 1].frame->size() <= bytes) {
+                    first--;
+                    slots--;
+                    bytes -= backlog[first].frame->size();
+                }
+            }
+            for (size_t i = first; i < backlog.size() && !c->closed; ++i) enqueue(c.get(), backlog[i].frame);
+        }
+        broadcast(c->room, atomic_load(&c->room->members), joined, nullptr);
+    }
+
+    void leaveRoom(Client* c) {
+        if (!c->room) return;
+        shared_ptr<Room> room = move(c->room);
+        c->members.reset();   // the snapshot references c itself
+        c->membersVersion = 0;
+        rooms.leave(room, c);
+        notice(room, "user " + to_string(c->id) + " left #" + room->name, c);
+    }
+
+    void notice(const shared_ptr<Room>& room, const string& text, const Client* exclude) {
+        broadcast(room, atomic_load(&room->members),
+                  make_shared<const string>(encodeFrame(MsgType::Notice, text)), exclude);
+    }
+
+    // Never blocks: local members get the message appended to their rings,
+    // every other worker with members in the room gets one inbox entry.
+    // seq is the message's history sequence number, 0 if it was not logged.
+    void broadcast(const shared_ptr<Room>& room, const shared_ptr<const Members>& members,
+                   const shared_ptr<const string>& msg, const Client* exclude, uint64_t seq = 0) {
+        for (size_t g = 0; g < members->groups.size(); ++g) {
+            const MemberGroup& group = members->groups[g];
+            if (group.worker == this) deliver(room, group, msg, exclude, seq);
+            else group.worker->post(new Delivery{msg, room, members, g, exclude, seq});
+        }
+    }
+
+    void deliver(const shared_ptr<Room>& room, const MemberGroup& group, const shared_ptr<const string>& msg,
+                 const Client* exclude, uint64_t seq) {
+        for (const shared_ptr<Client>& c : group.clients) {
+            // A snapshot can outlive a leave; skip members that have since moved on
+            if (c.get() == exclude || c->closed || c->room != room) continue;
+            if (seq && seq <= c->replayedThrough) continue;   // already sent by the join replay
+            enqueue(c.get(), msg);
+        }
+    }
+
+    void drainInbox() {
+        Delivery* d = inbox.exchange(nullptr, memory_order_acquire);
+        Delivery* ordered = nullptr;   // the stack is newest first; restore posting order
+        while (d) {
+            Delivery* next = d->next;
+            d->next = ordered;
+            ordered = d;
+            d = next;
+        }
+        while (ordered) {
+            Delivery* next = ordered->next;
+            deliver(ordered->room, ordered->members->groups[ordered->group], ordered->msg, ordered->exclude,
+                    ordered->seq);
+            delete ordered;
+            ordered = next;
+        }
+    }
+
+    void enqueue(Client* c, const shared_ptr<const string>& msg) {
+        if (!c->out.push(msg)) {
+            if (slowPolicy == SlowPolicy::Disconnect) {
+                cout << "Disconnecting slow user " << c->id << endl;
+                closeClient(c);
+                return;
+            }
+            // Make room from the oldest end; if nothing more can go, the new message is lost
+            bool queued = false;
+            while (!queued && c->out.dropOldest()) {
+                c->dropped++;
+                queued = c->out.push(msg);
+            }
+            if (!queued) {
+                c->dropped++;
+                return;
+            }
+        }
+        if (!c->dirty) {
+            c->dirty = true;
+            dirtyList.push_back(c);
+        }
+    }
+
+    void flush(Client* c) {
+        iovec iov[64];
+        while (!c->out.empty()) {
+            int cnt = c->out.fill(iov, 64);
+            ssize_t n = writev(c->fd, iov, cnt);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) break;
+                closeClient(c);
+                return;
+            }
+            c->out.consume(n);
+        }
+        bool want = !c->out.empty();
+        if (want != c->wantWrite) {
+            epoll_event ev = {};
+            ev.events = want ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            ev.data.ptr = c;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            c->wantWrite = want;
+        }
+    }
+
+    // The client leaves its room at the end of the loop iteration, after any
+    // remaining events and flush-list entries that point at it are skipped.
+    void closeClient(Client* c) {
+        if (c->closed) return;
+        if (c->dropped) cout << "User " << c->id << " left after " << c->dropped << " dropped messages" << endl;
+        c->closed = true;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, nullptr);
+        close(c->fd);
+        size_t index = c->index;
+        closedList.push_back(move(clients[index]));
+        if (index + 1 < clients.size()) {
+            clients[index] = move(clients.back());
+            clients[index]->index = index;
+        }
+        clients.pop_back();
+    }
+
+    int listenFd;
+    RoomRegistry& rooms;
+    int epfd;
+    int wakeFd;
+    atomic<Delivery*> inbox{nullptr};
+    vector<shared_ptr<Client>> clients;
+    vector<Client*> dirtyList;
+    vector<shared_ptr<Client>> closedList;
+};
+#else
+// Thread per client; each socket maps to its current room.
+unordered_map<SOCKET, string> clients;
 mutex clients_mutex;
 
-void broadcast(const string& msg, SOCKET sender) {
+void broadcast(const string& msg, const string& room, SOCKET sender) {
     lock_guard<mutex> lock(clients_mutex);
-    for (SOCKET client : clients) {
-        if (client != sender) {
-            send(client, msg.c_str(), msg.size(), 0);
+    for (const auto& client : clients) {
+        if (client.first != sender && client.second == room) {
+            send(client.first, msg.c_str(), (int)msg.size(), 0);
         }
     }
 }
 
 void handle_client(SOCKET client) {
-    char buffer[512];
-    while (true) {
-        int len = recv(client, buffer, sizeof(buffer)-1, 0);
+    string room = "lobby";
+    FrameReader in;
+    Frame frame;
+    FrameStatus status = FrameStatus::Incomplete;
+    while (status != FrameStatus::Error) {
+        char* dst = in.space(4096);
+        int len = recv(client, dst, (int)in.spaceLeft(), 0);
         if (len <= 0) break;
-        buffer[len] = 0;
-        string msg(buffer);
-        broadcast(msg, client);
+        in.commit(len);
+        while ((status = in.next(frame)) == FrameStatus::Complete) {
+            if (frame.type == MsgType::Chat) {
+                broadcast(string(frame.raw), room, client);
+            } else if (frame.type == MsgType::Join && !frame.payload.empty() && frame.payload.size() <= 64) {
+                room = string(frame.payload);
+                lock_guard<mutex> lock(clients_mutex);
+                clients[client] = room;
+            }
+        }
     }
     // Remove client
     {
         lock_guard<mutex> lock(clients_mutex);
-        clients.erase(remove(clients.begin(), clients.end(), client), clients.end());
+        clients.erase(client);
     }
-#ifdef _WIN32
-    closesocket(client);
-#else
-    close(client);
-#endif
+    closeSocket(client);
 }
+#endif
 
-int main() {
+int main(int argc, char* argv[]) {
+    int port = 9009;
+    int workers = max(1, (int)thread::hardware_concurrency());
+    struct {
+        string dir;
+        int replay = 50;
+        int segmentMb = 16;
+        int retainSegments = 4;
+        int syncMs = 100;
+    } hist;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--port=", 0) == 0) port = stoi(arg.substr(7));
+        else if (arg.rfind("--workers=", 0) == 0) workers = max(1, stoi(arg.substr(10)));
+        else if (arg.rfind("--queue-messages=", 0) == 0) queueMessages = max(1, stoi(arg.substr(17)));
+        else if (arg.rfind("--queue-bytes=", 0) == 0) queueBytes = max(1, stoi(arg.substr(14)));
+        else if (arg == "--slow-policy=drop") slowPolicy = SlowPolicy::DropOldest;
+        else if (arg == "--slow-policy=disconnect") slowPolicy = SlowPolicy::Disconnect;
+        else if (arg.rfind("--history-dir=", 0) == 0) hist.dir = arg.substr(14);
+        else if (arg.rfind("--replay=", 0) == 0) hist.replay = max(0, stoi(arg.substr(9)));
+        else if (arg.rfind("--segment-mb=", 0) == 0) hist.segmentMb = max(1, stoi(arg.substr(13)));
+        else if (arg.rfind("--retain-segments=", 0) == 0) hist.retainSegments = max(1, stoi(arg.substr(18)));
+        else if (arg.rfind("--sync-ms=", 0) == 0) hist.syncMs = max(1, stoi(arg.substr(10)));
+        else {
+            cerr << "Usage: " << argv[0] << " [--port=N] [--workers=N] [--queue-messages=N] [--queue-bytes=N]"
+                 << " [--slow-policy=drop|disconnect] [--history-dir=DIR] [--replay=N]"
+                 << " [--segment-mb=N] [--retain-segments=N] [--sync-ms=N]\n";
+            return 1;
+        }
+    }
 #ifdef _WIN32
     WSADATA wsa; WSAStartup(MAKEWORD(2,2), &wsa);
 #endif
-    int port = 9009;
     SOCKET server = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
     sockaddr_in addr = {};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
-    bind(server, (sockaddr*)&addr, sizeof(addr));
-    listen(server, 5);
+    if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        cerr << "Bind failed on port " << port << "\n";
+        return 1;
+    }
+    listen(server, SOMAXCONN);
 
     cout << "--- Chat Server Started on port " << port << " ---" << endl;
+#ifdef __linux__
+    signal(SIGPIPE, SIG_IGN);   // writev to a vanished peer must fail with EPIPE, not kill us
+    setNonBlocking(server);
+    if (!hist.dir.empty()) {
+        history = make_unique<MessageLog>(hist.dir, (size_t)hist.segmentMb << 20, hist.replay, hist.retainSegments);
+        if (!history->open()) {
+            cerr << "Cannot open history in " << hist.dir << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+        history->start(chrono::milliseconds(hist.syncMs));
+        cout << "History: " << hist.dir << " (" << history->segments() << " segments)" << endl;
+    }
+    RoomRegistry rooms;
+    vector<unique_ptr<Worker>> pool;
+    for (int i = 0; i < workers; ++i) pool.push_back(make_unique<Worker>(server, rooms));
+    cout << "Workers: " << workers << endl;
+    vector<thread> threads;
+    for (auto& worker : pool) threads.emplace_back([&worker]() { worker->run(); });
+    for (auto& t : threads) t.join();
+#else
+    (void)workers;   // one thread per client here
+    if (!hist.dir.empty()) cerr << "History is only supported on Linux; ignoring --history-dir\n";
     while (true) {
         sockaddr_in caddr;
         socklen_t clen = sizeof(caddr);
         SOCKET client = accept(server, (sockaddr*)&caddr, &clen);
+        if (client == INVALID_SOCKET) continue;
         {
             lock_guard<mutex> lock(clients_mutex);
-            clients.push_back(client);
+            clients[client] = "lobby";
         }
         thread(handle_client, client).detach();
     }
+#endif
 #ifdef _WIN32
     WSACleanup();
 #endif
@@ -0,0 +1,472 @@
+#pragma once
+// Bit-packed board for Life-like rules: 64 cells per 64-bit word, bit k of
+// word i in a row is cell x = 64*i + k. Every row carries one padding word on
+// each side and the board one padding row above and below, so neighbour words
+// can be read without bounds checks. On a bounded board the padding stays
+// zero and cells outside the board count as dead. On a wrapped board (a
+// torus) each step first copies the opposite edges into the padding.
+//
+// A generation is computed a word at a time with bitwise adders: 64 cells per
+// scalar operation, or 256 with AVX2. The rule is a template parameter of the
+// kernel, so the common rules compile to a handful of bit operations each.
+// The AVX2 path is chosen at runtime when the compiler supports it (GCC/Clang
+// on x86) and the CPU has it.
+//
+// The board is cut into tiles of TILE_ROWS rows by TILE_WORDS words, which a
+// pool of threads steps in parallel. Each generation reads only the current
+// buffer and each tile writes only its own part of the next one, so the rows
+// and words around a tile serve as its halo with no copying or locking. A
+// tile that neither changed itself nor had a neighbour change last generation
+// is skipped. Its next state equals its current one, and since it did not
+// change the other buffer already holds exactly that.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "LifeRule.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITBOARD_HAVE_AVX2 1
+#define BITBOARD_INLINE inline __attribute__((always_inline))
+#else
+#define BITBOARD_INLINE inline
+#endif
+
+namespace bitlife {
+
+#ifdef BITBOARD_HAVE_AVX2
+// Four words per value. Plain operators compile to AVX2 inside a
+// target("avx2") function, so no intrinsics are needed. Helpers pass vectors
+// by reference so no 32-byte value crosses a non-AVX2 function boundary.
+typedef uint64_t Word4 __attribute__((vector_size(32)));
+#endif
+
+template <class V>
+BITBOARD_INLINE void load(V& v, const uint64_t* p) { memcpy(&v, p, sizeof(V)); }
+
+// The three cells centred on each bit of the words at p, summed into s + 2c.
+// Left and right neighbours pull in the edge bit of the adjacent word.
+template <class V>
+BITBOARD_INLINE void rowSum(V& s, V& c, V& centre, const uint64_t* p) {
+    V prev, next;
+    load(centre, p);
+    load(prev, p - 1);
+    load(next, p + 1);
+    V l = (centre << 1) | (prev >> 63);
+    V r = (centre >> 1) | (next << 63);
+    s = l ^ centre ^ r;
+    c = (l & centre) | (r & (l ^ centre));
+}
+
+// Cells whose 3x3 total, given as bit planes t0..t3, is one of the totals in
+// MASK (bit k standing for a total of k). Unrolled at compile time. Totals
+// never exceed 9, so t3 only needs testing where t1 and t2 are both clear.
+template <unsigned MASK, unsigned K = 0, class V>
+BITBOARD_INLINE void totalIn(V& r, const V& t0, const V& t1, const V& t2, const V& t3) {
+    if constexpr (K < 10) {
+        if constexpr ((MASK >> K & 1) != 0) {
+            V hit;
+            if constexpr ((K & 1) != 0) hit = t0; else hit = ~t0;
+            if constexpr ((K & 2) != 0) hit &= t1; else hit &= ~t1;
+            if constexpr ((K & 4) != 0) hit &= t2; else hit &= ~t2;
+            if constexpr ((K & 8) != 0) hit &= t3; else if constexpr ((K & 6) == 0) hit &= ~t3;
+            r |= hit;
+        }
+        totalIn<MASK, K + 1>(r, t0, t1, t2, t3);
+    }
+}
+
+// A rule fixed at compile time. Counted with the cell itself, a dead cell's
+// total is its neighbour count n and a live cell's is n + 1. Totals that give
+// a live cell either way need no test of the cell.
+template <unsigned BIRTH, unsigned SURVIVE>
+struct FixedRule {
+    static const unsigned B = BIRTH, S = SURVIVE << 1;
+
+    explicit FixedRule(const LifeRule&) {}
+
+    template <class V>
+    BITBOARD_INLINE void apply(V& out, const V& t0, const V& t1, const V& t2, const V& t3, const V& m) const {
+        out = V{};
+        totalIn<B & S>(out, t0, t1, t2, t3);
+        if constexpr ((B & ~S) != 0) {
+            V born = {};
+            totalIn<B & ~S>(born, t0, t1, t2, t3);
+            out |= born & ~m;
+        }
+        if constexpr ((S & ~B) != 0) {
+            V kept = {};
+            totalIn<S & ~B>(kept, t0, t1, t2, t3);
+            out |= kept & m;
+        }
+    }
+};
+
+// Any other rule. The totals the rule cares about are listed once, each
+// with its bit pattern and whether it gives birth, survival or both, so the
+// per-word work is one match per listed total.
+struct AnyRule {
+    struct Total {
+        uint64_t bits[4];    // all-ones where the total has a 1 bit
+        uint64_t born, kept; // all-ones if the total gives birth / survival
+    };
+    Total totals[10];
+    int count = 0;
+
+    explicit AnyRule(const LifeRule& rule) {
+        unsigned b = rule.birth, s = (unsigned)rule.survive << 1;   // as totals, like FixedRule
+        for (unsigned k = 0; k < 10; k++) {
+            if (!((b | s) >> k & 1)) continue;
+            Total& t = totals[count++];
+            for (int i = 0; i < 4; i++) t.bits[i] = k >> i & 1 ? ~0ULL : 0;
+            t.born = b >> k & 1 ? ~0ULL : 0;
+            t.kept = s >> k & 1 ? ~0ULL : 0;
+        }
+    }
+
+    template <class V>
+    BITBOARD_INLINE void apply(V& out, const V& t0, const V& t1, const V& t2, const V& t3, const V& m) const {
+        V born = {}, kept = {};
+        for (int i = 0; i < count; i++) {
+            const Total& t = totals[i];
+            V hit = ~((t0 ^ t.bits[0]) | (t1 ^ t.bits[1]) | (t2 ^ t.bits[2]) | (t3 ^ t.bits[3]));
+            born |= hit & t.born;
+            kept |= hit & t.kept;
+        }
+        out = (born & ~m) | (kept & m);
+    }
+};
+
+// Next state for the words at p, given the row stride. Each row's three
+// horizontal neighbours are summed into s + 2c. The three rows are then added
+// into bit planes ones/twos/fours/eights of the 3x3 total, the cell itself
+// included, and the rule maps totals to new states. Cells outside mask stay
+// dead; cells that flipped are ORed into diff.
+template <class V, class Rule>
+BITBOARD_INLINE void lifeWord(uint64_t* out, const uint64_t* p, size_t stride, uint64_t mask, V& diff,
+                              const Rule& rule) {
+    V sa, ca, a, sm, cm, m, sb, cb, b;
+    rowSum(sa, ca, a, p - stride);
+    rowSum(sm, cm, m, p);
+    rowSum(sb, cb, b, p + stride);
+
+    V ones = sa ^ sm ^ sb;
+    V k = (sa & sm) | (sb & (sa ^ sm));                     // carry into twos
+    V t = ca ^ cm ^ cb, f1 = (ca & cm) | (cb & (ca ^ cm));
+    V twos = t ^ k, f2 = t & k;
+    V fours = f1 ^ f2, eights = f1 & f2;
+
+    V result;
+    rule.apply(result, ones, twos, fours, eights, m);
+    result &= mask;
+    diff |= result ^ (m & mask);   // bits past the edge may hold wrapped cells
+    memcpy(out, &result, sizeof(V));
+}
+
+// Steps the tile of rows [y0, y1) and words [w0, w1) from src into dst and
+// reports whether any of its cells changed. LANES words go per vector step,
+// and leftovers use the scalar kernel.
+template <class V, int LANES, class Rule>
+BITBOARD_INLINE bool stepRows(const uint64_t* src, uint64_t* dst, size_t stride, int words, uint64_t tailMask,
+                              int y0, int y1, int w0, int w1, const Rule& rule) {
+    V diff = {};
+    uint64_t scalarDiff = 0;
+    int end = w1 == words ? words - 1 : w1;   // the row's last word gets tailMask
+    for (int y = y0; y < y1; y++) {
+        size_t off = (size_t)(y + 1) * stride + 1;
+        const uint64_t* in = src + off;
+        uint64_t* out = dst + off;
+        int i = w0;
+        for (; i + LANES <= end; i += LANES) lifeWord<V>(out + i, in + i, stride, ~0ULL, diff, rule);
+        for (; i < end; i++) lifeWord<uint64_t>(out + i, in + i, stride, ~0ULL, scalarDiff, rule);
+        if (end < w1) lifeWord<uint64_t>(out + end, in + end, stride, tailMask, scalarDiff, rule);
+    }
+    uint64_t lanes[sizeof(V) / sizeof(uint64_t)];
+    memcpy(lanes, &diff, sizeof(V));
+    for (uint64_t lane : lanes) scalarDiff |= lane;
+    return scalarDiff != 0;
+}
+
+typedef bool (*StepFn)(const uint64_t* src, uint64_t* dst, size_t stride, int words, uint64_t tailMask, int y0,
+                       int y1, int w0, int w1, const LifeRule& rule);
+
+template <class Rule>
+bool stepRowsScalar(const uint64_t* src, uint64_t* dst, size_t stride, int words, uint64_t tailMask, int y0,
+                    int y1, int w0, int w1, const LifeRule& rule) {
+    return stepRows<uint64_t, 1>(src, dst, stride, words, tailMask, y0, y1, w0, w1, Rule(rule));
+}
+
+#ifdef BITBOARD_HAVE_AVX2
+template <class Rule>
+__attribute__((target("avx2"))) bool stepRowsAvx2(const uint64_t* src, uint64_t* dst, size_t stride, int words,
+                                                   uint64_t tailMask, int y0, int y1, int w0, int w1,
+                                                   const LifeRule& rule) {
+    return stepRows<Word4, 4>(src, dst, stride, words, tailMask, y0, y1, w0, w1, Rule(rule));
+}
+#endif
+
+inline bool cpuHasAvx2() {
+#ifdef BITBOARD_HAVE_AVX2
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+template <class Rule>
+StepFn kernel() {
+#ifdef BITBOARD_HAVE_AVX2
+    if (cpuHasAvx2()) return stepRowsAvx2<Rule>;
+#endif
+    return stepRowsScalar<Rule>;
+}
+
+// The stepping function for rule: a compile-time kernel for the rules named
+// in parseRule, and the runtime one for the rest.
+inline StepFn kernelFor(const LifeRule& rule) {
+    static const struct {
+        uint16_t birth, survive;
+        StepFn (*make)();
+    } FIXED[] = {
+        {countMask("3"), countMask("23"), kernel<FixedRule<countMask("3"), countMask("23")>>},
+        {countMask("36"), countMask("23"), kernel<FixedRule<countMask("36"), countMask("23")>>},
+        {countMask("2"), countMask(""), kernel<FixedRule<countMask("2"), countMask("")>>},
+        {countMask("3678"), countMask("34678"), kernel<FixedRule<countMask("3678"), countMask("34678")>>},
+        {countMask("368"), countMask("245"), kernel<FixedRule<countMask("368"), countMask("245")>>},
+        {countMask("36"), countMask("125"), kernel<FixedRule<countMask("36"), countMask("125")>>},
+        {countMask("1357"), countMask("1357"), kernel<FixedRule<countMask("1357"), countMask("1357")>>},
+    };
+    for (const auto& fixed : FIXED)
+        if (rule.birth == fixed.birth && rule.survive == fixed.survive) return fixed.make();
+    return kernel<AnyRule>();
+}
+
+// Runs one job on every worker thread and the caller, and returns when all
+// of them are done. Workers sleep between jobs instead of being started for
+// each generation.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int i = 1; i < threads; i++) workers.emplace_back([this] { loop(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void run(const std::function<void()>& fn) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = &fn;
+            pending = (int)workers.size();
+            round++;
+        }
+        wake.notify_all();
+        fn();
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    void loop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(m);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || round != seen; });
+            if (stopping) return;
+            seen = round;
+            const std::function<void()>* fn = job;
+            lock.unlock();
+            (*fn)();
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake, done;
+    const std::function<void()>* job = nullptr;
+    uint64_t round = 0;   // bumped once per job so each worker runs it once
+    int pending = 0;      // workers still running the current job
+    bool stopping = false;
+};
+
+} // namespace bitlife
+
+class BitBoard {
+public:
+    static const int TILE_ROWS = 32, TILE_WORDS = 8;   // 512 x 32 cells, 2 KB
+
+    // Timing and skip counts for the most recent step()
+    struct StepStats {
+        double ms = 0;
+        size_t activeTiles = 0, tiles = 0;
+    };
+
+    BitBoard(int width, int height, int threads = 1, const LifeRule& rule = LifeRule(), bool wrap = false)
+        : w(width), h(height), words((width + 63) / 64), stride((size_t)words + 2), rule(rule), wrap(wrap),
+          stepFn(bitlife::kernelFor(rule)),
+          cur((size_t)(height + 2) * stride, 0), next(cur.size(), 0),
+          tailMask(width % 64 ? (1ULL << (width % 64)) - 1 : ~0ULL),
+          tilesX((words + TILE_WORDS - 1) / TILE_WORDS), tilesY((height + TILE_ROWS - 1) / TILE_ROWS),
+          changed((size_t)tilesX * tilesY, 1), nextChanged(changed.size(), 0), activeMap(changed.size(), 0) {
+        if (threads > 1) pool.reset(new bitlife::WorkerPool(threads));
+        stats.tiles = changed.size();
+    }
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int threads() const { return pool ? pool->size() : 1; }
+    const LifeRule& lifeRule() const { return rule; }
+    bool wraps() const { return wrap; }
+    const StepStats& lastStep() const { return stats; }
+
+    bool get(int x, int y) const { return (row(cur, y)[x >> 6] >> (x & 63)) & 1; }
+
+    void set(int x, int y, bool alive) {
+        uint64_t bit = 1ULL << (x & 63);
+        uint64_t& word = row(cur, y)[x >> 6];
+        word = alive ? word | bit : word & ~bit;
+        changed[(size_t)(y / TILE_ROWS) * tilesX + (x >> 6) / TILE_WORDS] = 1;
+    }
+
+    void clear() {
+        std::fill(cur.begin(), cur.end(), 0);
+        std::fill(changed.begin(), changed.end(), 1);
+    }
+
+    // About a quarter of the cells alive: AND of two random words.
+    void randomize(uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        for (int y = 0; y < h; y++) {
+            uint64_t* r = row(cur, y);
+            for (int i = 0; i < words; i++) r[i] = rng() & rng();
+            r[words - 1] &= tailMask;
+        }
+        std::fill(changed.begin(), changed.end(), 1);
+    }
+
+    void step() {
+        auto start = std::chrono::steady_clock::now();
+        if (wrap) fillHalo();
+        collectActive();
+        std::fill(nextChanged.begin(), nextChanged.end(), 0);
+        std::atomic<size_t> nextTile(0);
+        auto work = [&] {
+            for (size_t i; (i = nextTile.fetch_add(1)) < active.size();) stepTile(active[i]);
+        };
+        if (pool && active.size() > 1)
+            pool->run(work);
+        else
+            work();
+        cur.swap(next);
+        changed.swap(nextChanged);
+        stats.activeTiles = active.size();
+        stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint64_t population() const {
+        uint64_t n = 0;
+        for (int y = 0; y < h; y++) {
+            const uint64_t* r = row(cur, y);
+            for (int i = 0; i < words - 1; i++) n += popcount(r[i]);
+            n += popcount(r[words - 1] & tailMask);   // past the edge may sit a wrapped cell
+        }
+        return n;
+    }
+
+private:
+    static int popcount(uint64_t v) {
+#ifdef __GNUC__
+        return __builtin_popcountll(v);
+#else
+        int n = 0;
+        for (; v; v &= v - 1) n++;
+        return n;
+#endif
+    }
+
+    // Copies the opposite edges of a wrapped board into the cells just past
+    // it: each row's last cell to bit 63 of its left padding word and its
+    // first cell to the bit after its last, then the bottom row above the top
+    // and the top row below the bottom, padding and all, for the corners.
+    void fillHalo() {
+        int last = w - 1;
+        for (int y = 0; y < h; y++) {
+            uint64_t* r = row(cur, y);
+            r[-1] = (r[last >> 6] >> (last & 63) & 1) << 63;
+            r[words - 1] &= tailMask;
+            r[words] = 0;
+            r[w >> 6] |= (r[0] & 1) << (w & 63);
+        }
+        std::copy_n(row(cur, h - 1) - 1, stride, cur.begin());
+        std::copy_n(row(cur, 0) - 1, stride, cur.begin() + (size_t)(h + 1) * stride);
+    }
+
+    // Tiles that changed last generation, plus their neighbours, which on a
+    // wrapped board include those across each edge
+    void collectActive() {
+        std::fill(activeMap.begin(), activeMap.end(), 0);
+        for (int ty = 0; ty < tilesY; ty++)
+            for (int tx = 0; tx < tilesX; tx++) {
+                if (!changed[(size_t)ty * tilesX + tx]) continue;
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int y = ty + dy, x = tx + dx;
+                        if (wrap) {
+                            y = (y + tilesY) % tilesY;
+                            x = (x + tilesX) % tilesX;
+                        } else if (y < 0 || y >= tilesY || x < 0 || x >= tilesX) {
+                            continue;
+                        }
+                        activeMap[(size_t)y * tilesX + x] = 1;
+                    }
+            }
+        active.clear();
+        for (size_t t = 0; t < activeMap.size(); t++)
+            if (activeMap[t]) active.push_back((uint32_t)t);
+    }
+
+    void stepTile(uint32_t t) {
+        int y0 = (int)(t / tilesX) * TILE_ROWS, w0 = (int)(t % tilesX) * TILE_WORDS;
+        int y1 = std::min(h, y0 + TILE_ROWS), w1 = std::min(words, w0 + TILE_WORDS);
+        nextChanged[t] = stepFn(cur.data(), next.data(), stride, words, tailMask, y0, y1, w0, w1, rule);
+    }
+
+    uint64_t* row(std::vector<uint64_t>& b, int y) { return b.data() + (size_t)(y + 1) * stride + 1; }
+    const uint64_t* row(const std::vector<uint64_t>& b, int y) const {
+        return b.data() + (size_t)(y + 1) * stride + 1;
+    }
+
+    int w, h, words;
+    size_t stride;                    // words per stored row, padding included
+    LifeRule rule;
+    bool wrap;
+    bitlife::StepFn stepFn;           // kernel compiled for rule
+    std::vector<uint64_t> cur, next;
+    uint64_t tailMask;                // live bits of each row's last word
+    int tilesX, tilesY;
+    std::vector<uint8_t> changed;     // per tile: did it change last generation
+    std::vector<uint8_t> nextChanged, activeMap;
+    std::vector<uint32_t> active;     // tiles to step this generation
+    std::unique_ptr<bitlife::WorkerPool> pool;   // null when single-threaded
+    StepStats stats;
+};
@@ -0,0 +1,307 @@
+#pragma once
+// HashLife (Gosper's algorithm). The universe is a quadtree whose nodes are
+// hash-consed, so identical regions anywhere in space or time are a single
+// node. Each node memoizes its centre advanced a power-of-two number of
+// generations. A pattern with repeating structure can then jump 2^N
+// generations in time that depends on how varied it is, not on N or its area.
+//
+// A node of level k is a 2^k square. Level 0 holds the two single cells
+// (ids 0 and 1), and every other node holds four children of level k-1.
+// Nodes live in one vector and refer to each other by index. A child is
+// always created before its parent, so children have smaller ids. The
+// universe is unbounded and centred on (0,0). When memory use passes the cap
+// between steps, nodes not reachable from the current universe are dropped
+// and the vector is compacted. Any Life-like rule without B0 works, as none
+// spreads faster than one cell per generation or brings empty space alive.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LifeRule.h"
+
+class HashLife {
+public:
+    typedef uint32_t NodeId;
+
+    explicit HashLife(size_t memoryCapBytes, const LifeRule& rule = LifeRule()) : cap(memoryCapBytes), rule(rule) {
+        clear();
+    }
+
+    void clear() {
+        nodes.clear();
+        nodes.push_back(Node{0, 0, 0, 0, NONE, 0, 0});   // dead cell
+        nodes.push_back(Node{0, 0, 0, 0, NONE, 0, 1});   // live cell
+        table.assign(1 << 16, 0);
+        tableUsed = 0;
+        empties.assign(1, 0);
+        memoExp = -1;
+        gen = 0;
+        gcs = 0;
+        root = empty(3);
+    }
+
+    void setCell(int64_t x, int64_t y, bool alive) {
+        while (!inside(x, y)) root = expand(root);
+        int64_t half = span(level(root)) / 2;
+        root = setRec(root, (uint64_t)(x + half), (uint64_t)(y + half), alive);
+    }
+
+    bool getCell(int64_t x, int64_t y) const {
+        if (!inside(x, y)) return false;
+        int64_t half = span(level(root)) / 2;
+        uint64_t ux = (uint64_t)(x + half), uy = (uint64_t)(y + half);
+        NodeId n = root;
+        for (int l = level(root); l > 0; l--) {
+            const Node& node = nodes[n];
+            if (node.pop == 0) return false;
+            uint64_t h = 1ULL << (l - 1);
+            bool east = ux & h, south = uy & h;
+            n = south ? (east ? node.se : node.sw) : (east ? node.ne : node.nw);
+        }
+        return n == 1;
+    }
+
+    // Advances the universe by 2^exp generations (exp <= MAX_STEP_EXP)
+    void advance(int exp) {
+        if (exp != memoExp) {
+            for (Node& n : nodes) n.result = NONE;   // memos are for one step size
+            memoExp = exp;
+        }
+        // Grow until the live cells sit in the central quarter and the
+        // step is at most 2^(level-3). Then even growth at one cell per
+        // generation stays inside the half-size centre that step() returns.
+        while (level(root) < std::max(4, exp + 3) || !centred()) root = expand(root);
+        root = step(root, exp);
+        gen += 1ULL << exp;
+        if (memoryUsed() > cap) collect();
+    }
+
+    static const int MAX_STEP_EXP = 50;
+
+    uint64_t population() const { return nodes[root].pop; }
+    uint64_t generation() const { return gen; }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t memoryUsed() const { return nodes.capacity() * sizeof(Node) + table.size() * sizeof(NodeId); }
+    unsigned gcCount() const { return gcs; }
+
+private:
+    static const NodeId NONE = 0xffffffffu;
+
+    struct Node {
+        NodeId nw, ne, sw, se;
+        NodeId result;   // centre after 2^memoExp generations, or NONE
+        uint32_t level;
+        uint64_t pop;
+    };
+
+    static int64_t span(int lvl) { return (int64_t)1 << lvl; }
+    int level(NodeId n) const { return (int)nodes[n].level; }
+
+    bool inside(int64_t x, int64_t y) const {
+        int64_t half = span(level(root)) / 2;
+        return x >= -half && x < half && y >= -half && y < half;
+    }
+
+    static size_t hash(NodeId a, NodeId b, NodeId c, NodeId d) {
+        uint64_t h = a * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ b) * 0xC2B2AE3D27D4EB4FULL;
+        h = (h ^ c) * 0x165667B19E3779F9ULL;
+        h = (h ^ d) * 0x9E3779B97F4A7C15ULL;
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    // The one node with these children, created on first use. Slot value 0
+    // marks an empty slot; the dead cell is never stored in the table.
+    NodeId join(NodeId nw, NodeId ne, NodeId sw, NodeId se) {
+        size_t mask = table.size() - 1;
+        for (size_t i = hash(nw, ne, sw, se) & mask;; i = (i + 1) & mask) {
+            NodeId id = table[i];
+            if (id == 0) {
+                id = (NodeId)nodes.size();
+                nodes.push_back(Node{nw, ne, sw, se, NONE, nodes[nw].level + 1,
+                                     nodes[nw].pop + nodes[ne].pop + nodes[sw].pop + nodes[se].pop});
+                table[i] = id;
+                if (++tableUsed * 2 > table.size()) rehash(table.size() * 2);
+                return id;
+            }
+            const Node& n = nodes[id];
+            if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se) return id;
+        }
+    }
+
+    void rehash(size_t size) {
+        table.assign(size, 0);
+        tableUsed = 0;
+        size_t mask = size - 1;
+        for (NodeId id = 2; id < nodes.size(); id++) {
+            const Node& n = nodes[id];
+            size_t i = hash(n.nw, n.ne, n.sw, n.se) & mask;
+            while (table[i]) i = (i + 1) & mask;
+            table[i] = id;
+            tableUsed++;
+        }
+    }
+
+    NodeId empty(int lvl) {
+        while ((int)empties.size() <= lvl) {
+            NodeId e = empties.back();
+            empties.push_back(join(e, e, e, e));
+        }
+        return empties[lvl];
+    }
+
+    // Same contents centred in a node twice the size
+    NodeId expand(NodeId n) {
+        Node c = nodes[n];
+        NodeId e = empty((int)c.level - 1);
+        return join(join(e, e, e, c.nw), join(e, e, c.ne, e), join(e, c.sw, e, e), join(c.se, e, e, e));
+    }
+
+    bool centred() const {
+        const Node& r = nodes[root];
+        auto grand = [&](NodeId a, int q1, int q2) {
+            const Node& n = nodes[a];
+            NodeId c = q1 == 0 ? n.nw : q1 == 1 ? n.ne : q1 == 2 ? n.sw : n.se;
+            const Node& m = nodes[c];
+            return q2 == 0 ? m.nw : q2 == 1 ? m.ne : q2 == 2 ? m.sw : m.se;
+        };
+        uint64_t inner = nodes[grand(r.nw, 3, 3)].pop + nodes[grand(r.ne, 2, 2)].pop +
+                         nodes[grand(r.sw, 1, 1)].pop + nodes[grand(r.se, 0, 0)].pop;
+        return inner == r.pop;
+    }
+
+    NodeId setRec(NodeId n, uint64_t x, uint64_t y, bool alive) {
+        int lvl = level(n);
+        if (lvl == 0) return alive ? 1 : 0;
+        Node c = nodes[n];
+        uint64_t h = 1ULL << (lvl - 1);
+        if (y < h) {
+            if (x < h) c.nw = setRec(c.nw, x, y, alive);
+            else c.ne = setRec(c.ne, x - h, y, alive);
+        } else {
+            if (x < h) c.sw = setRec(c.sw, x, y - h, alive);
+            else c.se = setRec(c.se, x - h, y - h, alive);
+        }
+        return join(c.nw, c.ne, c.sw, c.se);
+    }
+
+    // Centre 2x2 of a 4x4 node after one generation
+    NodeId baseStep(NodeId n) {
+        int cells[4][4];
+        const Node& node = nodes[n];
+        NodeId quads[4] = {node.nw, node.ne, node.sw, node.se};
+        for (int q = 0; q < 4; q++) {
+            const Node& c = nodes[quads[q]];
+            int x0 = (q & 1) * 2, y0 = (q >> 1) * 2;
+            cells[y0][x0] = (int)c.nw;
+            cells[y0][x0 + 1] = (int)c.ne;
+            cells[y0 + 1][x0] = (int)c.sw;
+            cells[y0 + 1][x0 + 1] = (int)c.se;
+        }
+        NodeId out[4];
+        for (int i = 0; i < 4; i++) {
+            int x = 1 + (i & 1), y = 1 + (i >> 1), count = 0;
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                    if (dx || dy) count += cells[y + dy][x + dx];
+            out[i] = rule.next(cells[y][x], count);
+        }
+        return join(out[0], out[1], out[2], out[3]);
+    }
+
+    NodeId centre(NodeId n) {
+        Node c = nodes[n];
+        return join(nodes[c.nw].se, nodes[c.ne].sw, nodes[c.sw].ne, nodes[c.se].nw);
+    }
+
+    // Centre (level k-1) of a level-k node advanced 2^min(j, k-2)
+    // generations, so for a fixed j every node's memo means one thing. The
+    // node is cut into nine overlapping level k-1 squares, each centre is
+    // advanced, and the results are regrouped into four squares whose centres
+    // form the answer. For a full step (j >= k-2) the second round advances
+    // again, each round taking half. Otherwise the first round covers all 2^j
+    // generations and the second just takes the centres.
+    NodeId step(NodeId n, int j) {
+        Node c = nodes[n];
+        if (c.result != NONE) return c.result;
+        NodeId result;
+        if (c.pop == 0) result = empty((int)c.level - 1);
+        else if (c.level == 2) result = baseStep(n);
+        else result = stepChildren(c, j);
+        nodes[n].result = result;
+        return result;
+    }
+
+    NodeId stepChildren(const Node& c, int j) {
+        Node nw = nodes[c.nw], ne = nodes[c.ne], sw = nodes[c.sw], se = nodes[c.se];
+        NodeId sub[9] = {
+            c.nw, join(nw.ne, ne.nw, nw.se, ne.sw), c.ne,
+            join(nw.sw, nw.se, sw.nw, sw.ne), join(nw.se, ne.sw, sw.ne, se.nw), join(ne.sw, ne.se, se.nw, se.ne),
+            c.sw, join(sw.ne, se.nw, sw.se, se.sw), c.se,
+        };
+        bool full = j >= (int)c.level - 2;
+        NodeId r[9];
+        for (int i = 0; i < 9; i++) r[i] = step(sub[i], j);
+        NodeId quad[4] = {join(r[0], r[1], r[3], r[4]), join(r[1], r[2], r[4], r[5]),
+                          join(r[3], r[4], r[6], r[7]), join(r[4], r[5], r[7], r[8])};
+        NodeId out[4];
+        for (int i = 0; i < 4; i++) out[i] = full ? step(quad[i], j) : centre(quad[i]);
+        return join(out[0], out[1], out[2], out[3]);
+    }
+
+    // Keeps the universe, the empty nodes and memos that point at kept nodes;
+    // renumbers in id order so children still come before parents.
+    void collect() {
+        std::vector<uint8_t> keep(nodes.size(), 0);
+        std::vector<NodeId> stack(empties.begin(), empties.end());
+        stack.push_back(root);
+        keep[0] = keep[1] = 1;
+        while (!stack.empty()) {
+            NodeId id = stack.back();
+            stack.pop_back();
+            if (keep[id]) continue;
+            keep[id] = 1;
+            const Node& n = nodes[id];
+            stack.push_back(n.nw);
+            stack.push_back(n.ne);
+            stack.push_back(n.sw);
+            stack.push_back(n.se);
+        }
+        std::vector<NodeId> renumber(nodes.size(), NONE);
+        std::vector<Node> kept;
+        kept.reserve(nodes.size() / 2);
+        for (NodeId id = 0; id < nodes.size(); id++) {
+            if (!keep[id]) continue;
+            renumber[id] = (NodeId)kept.size();
+            Node n = nodes[id];
+            if (id > 1) {
+                n.nw = renumber[n.nw];
+                n.ne = renumber[n.ne];
+                n.sw = renumber[n.sw];
+                n.se = renumber[n.se];
+            }
+            kept.push_back(n);
+        }
+        for (Node& n : kept)
+            n.result = n.result == NONE ? NONE : renumber[n.result];
+        nodes.swap(kept);
+        for (NodeId& e : empties) e = renumber[e];
+        root = renumber[root];
+        size_t size = 1 << 16;
+        while (size < nodes.size() * 2) size *= 2;
+        rehash(size);
+        gcs++;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<NodeId> table;      // open addressing over node ids
+    size_t tableUsed = 0;
+    std::vector<NodeId> empties;    // empty node of each level
+    NodeId root = 0;
+    int memoExp = -1;
+    uint64_t gen = 0;
+    size_t cap;
+    LifeRule rule;
+    unsigned gcs = 0;
+};
@@ -0,0 +1,78 @@
+#pragma once
+// Life-like rules: a dead cell is born when its count of live neighbours is
+// in the birth set, and a live cell survives when its count is in the
+// survival set. Written "B36/S23" (birth first, as RLE files and Golly do),
+// the older "23/36" (survival first), or by one of the names in parseRule.
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+struct LifeRule {
+    uint16_t birth = 1 << 3;                 // bit n: born with n neighbours
+    uint16_t survive = 1 << 2 | 1 << 3;      // bit n: survives with n neighbours
+
+    bool next(bool alive, int neighbours) const { return ((alive ? survive : birth) >> neighbours) & 1; }
+
+    bool operator==(const LifeRule& o) const { return birth == o.birth && survive == o.survive; }
+
+    std::string toString() const {
+        std::string s = "B";
+        for (int n = 0; n <= 8; n++)
+            if (birth >> n & 1) s += char('0' + n);
+        s += "/S";
+        for (int n = 0; n <= 8; n++)
+            if (survive >> n & 1) s += char('0' + n);
+        return s;
+    }
+};
+
+// Neighbour-count mask of a digit string, e.g. "23" -> bits 2 and 3
+constexpr uint16_t countMask(const char* digits) {
+    uint16_t mask = 0;
+    for (; *digits; digits++) mask |= 1 << (*digits - '0');
+    return mask;
+}
+
+// Parses a rule string or name, ignoring case. Returns false when text is
+// neither. B0 rules are refused: they turn empty space alive, which neither
+// a bounded board's dead border nor HashLife's empty universe can express.
+inline bool parseRule(const std::string& text, LifeRule& rule) {
+    std::string s;
+    for (char ch : text)
+        if (!isspace((unsigned char)ch)) s += (char)tolower((unsigned char)ch);
+
+    static const struct { const char* name; const char* rule; } NAMED[] = {
+        {"life", "b3/s23"},       {"conway", "b3/s23"},     {"highlife", "b36/s23"},
+        {"seeds", "b2/s"},        {"daynight", "b3678/s34678"}, {"day&night", "b3678/s34678"},
+        {"morley", "b368/s245"},  {"2x2", "b36/s125"},      {"replicator", "b1357/s1357"},
+    };
+    for (const auto& named : NAMED)
+        if (s == named.name) s = named.rule;
+
+    uint16_t masks[2] = {0, 0};   // B, S
+    bool seen[2] = {false, false};
+    if (s.find_first_of("bs") == std::string::npos) {
+        // Survival/birth digits: "23/3"
+        size_t slash = s.find('/');
+        if (slash == std::string::npos) return false;
+        s = "s" + s.substr(0, slash) + "/b" + s.substr(slash + 1);
+    }
+    int part = -1;
+    for (size_t i = 0; i < s.size(); i++) {
+        char ch = s[i];
+        if (ch == 'b' || ch == 's') {
+            part = ch == 'b' ? 0 : 1;
+            if (seen[part]) return false;
+            seen[part] = true;
+        } else if (ch >= '0' && ch <= '8' && part >= 0) {
+            masks[part] |= 1 << (ch - '0');
+        } else if (ch != '/') {
+            return false;
+        }
+    }
+    if (!seen[0] || !seen[1] || (masks[0] & 1)) return false;
+    rule.birth = masks[0];
+    rule.survive = masks[1];
+    return true;
+}
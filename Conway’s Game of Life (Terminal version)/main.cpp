@@ -1,74 +1,365 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <vector>
+#include <memory>
 #include <cstdlib>
+#include <cstdio>
+#include <cctype>
 #include <ctime>
+#include <random>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include "BitBoard.h"
+#include "HashLife.h"
 using namespace std;
 
-const int WIDTH = 20, HEIGHT = 15;
+// Usage: main [--engine=bitboard|hashlife] [--width=N] [--height=N] [--pattern=FILE.rle]
+//             [--step-exp=N] [--hashlife-mb=N] [--threads=N] [--seed=N] [--delay-ms=N]
+//             [--rule=RULE] [--topology=bounded|wrap]
+// bitboard steps a width x height board where cells past the edge are dead,
+// or wrap around with --topology=wrap. hashlife runs an unbounded universe
+// and can jump far ahead. Each frame advances 2^N generations (--step-exp,
+// default 0) with either engine. Without --pattern the middle width x height
+// region starts random. The view shows the middle of the universe. --threads
+// sets how many threads step the bitboard (default: one per core). --seed
+// fixes the random start and --delay-ms the pause between frames. --rule
+// picks a Life-like rule (default B3/S23, or the pattern file's rule).
+//        main --bench[=FRAMES] [...]   run FRAMES frames (default 1000) without
+//                                      drawing, print the speed and exit
+const int VIEW_WIDTH = 40, VIEW_HEIGHT = 30;
 const char LIVE = 'O', DEAD = '.';
 
-void clearScreen() {
-    // ANSI escape code to clear terminal (works in most), else just print newlines
-    cout << "\033[2J\033[H";
-}
+// What the display loop needs from an engine. (0,0) is the middle of the
+// universe.
+class LifeEngine {
+public:
+    virtual ~LifeEngine() {}
+    virtual void setCell(long long x, long long y) = 0;
+    virtual void advance(int exp) = 0;   // 2^exp generations
+    virtual bool alive(long long x, long long y) const = 0;
+    virtual uint64_t population() const = 0;
+    virtual string status() const = 0;
 
-void printGrid(const vector<vector<char>>& grid) {
-    for (int y = 0; y < HEIGHT; ++y) {
-        for (int x = 0; x < WIDTH; ++x)
-            cout << grid[y][x] << ' ';
-        cout << '\n';
+    // About a quarter of the cells in the middle width x height region alive
+    virtual void randomize(int width, int height, uint64_t seed) {
+        mt19937_64 rng(seed);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x += 64) {
+                uint64_t bits = rng() & rng();
+                for (int b = 0; b < 64 && x + b < width; b++)
+                    if (bits >> b & 1) setCell(x + b - width / 2, y - height / 2);
+            }
+    }
+};
+
+class BitBoardEngine : public LifeEngine {
+public:
+    BitBoardEngine(int width, int height, int threads, const LifeRule& rule, bool wrap)
+        : board(width, height, threads, rule, wrap) {}
+
+    void setCell(long long x, long long y) override {
+        x += board.width() / 2;
+        y += board.height() / 2;
+        if (x >= 0 && x < board.width() && y >= 0 && y < board.height()) board.set((int)x, (int)y, true);
+    }
+
+    void randomize(int, int, uint64_t seed) override { board.randomize(seed); }
+
+    void advance(int exp) override {
+        totalMs = 0;
+        steps = 1ULL << exp;
+        for (uint64_t i = 0; i < steps; i++) {
+            board.step();
+            totalMs += board.lastStep().ms;
+        }
+    }
+
+    bool alive(long long x, long long y) const override {
+        x += board.width() / 2;
+        y += board.height() / 2;
+        return x >= 0 && x < board.width() && y >= 0 && y < board.height() && board.get((int)x, (int)y);
+    }
+
+    uint64_t population() const override { return board.population(); }
+
+    // Milliseconds per generation averaged over the last frame, and how many
+    // tiles the last generation actually stepped
+    string status() const override {
+        const BitBoard::StepStats& last = board.lastStep();
+        char timing[32];
+        snprintf(timing, sizeof(timing), "%.3f ms/gen", steps ? totalMs / steps : 0.0);
+        return "bitboard " + to_string(board.width()) + "x" + to_string(board.height()) +
+               (board.wraps() ? " wrapped, " : ", ") + board.lifeRule().toString() + ", " +
+               to_string(board.threads()) + " threads, " + to_string(last.activeTiles) + "/" +
+               to_string(last.tiles) + " tiles active, " + timing;
     }
-}
 
-int countLiveNeighbours(const vector<vector<char>>& grid, int x, int y) {
-    int cnt = 0;
-    for (int dy = -1; dy <= 1; ++dy)
-        for (int dx = -1; dx <= 1; ++dx)
-            if (!(dx == 0 && dy == 0)) {
-                int nx = x + dx, ny = y + dy;
-                if (nx >= 0 && nx < WIDTH && ny >= 0 && ny < HEIGHT)
-                    cnt += grid[ny][nx] == LIVE ? 1 : 0;
+private:
+    BitBoard board;
+    double totalMs = 0;
+    uint64_t steps = 0;
+};
+
+class HashLifeEngine : public LifeEngine {
+public:
+    HashLifeEngine(size_t memoryCapBytes, const LifeRule& rule) : life(memoryCapBytes, rule), rule(rule) {}
+
+    void setCell(long long x, long long y) override { life.setCell(x, y, true); }
+    void advance(int exp) override { life.advance(exp); }
+    bool alive(long long x, long long y) const override { return life.getCell(x, y); }
+    uint64_t population() const override { return life.population(); }
+
+    string status() const override {
+        return "hashlife, " + rule.toString() + ", " + to_string(life.nodeCount()) + " nodes, " + to_string(life.memoryUsed() >> 20) +
+               " MB, " + to_string(life.gcCount()) + " GCs";
+    }
+
+private:
+    HashLife life;
+    LifeRule rule;
+};
+
+// A pattern read from an RLE file: the "x = .., y = .., rule = .." header,
+// then runs like 3o2b$ where b is dead, any other letter alive, $ ends a row
+// and ! ends the pattern.
+struct Pattern {
+    int width = 0, height = 0;
+    string rule;
+    vector<pair<int, int>> cells;
+};
+
+bool loadRle(const string& path, Pattern& pat) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    string line;
+    int x = 0, y = 0, run = 0;
+    bool header = false, done = false;
+    while (!done && getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        if (!header && line.find('=') != string::npos) {
+            header = true;
+            stringstream fields(line);
+            string field;
+            while (getline(fields, field, ',')) {
+                size_t eq = field.find('=');
+                if (eq == string::npos) continue;
+                string key = field.substr(0, eq), value = field.substr(eq + 1);
+                key.erase(remove_if(key.begin(), key.end(), ::isspace), key.end());
+                value.erase(remove_if(value.begin(), value.end(), ::isspace), value.end());
+                if (key == "x") pat.width = atoi(value.c_str());
+                else if (key == "y") pat.height = atoi(value.c_str());
+                else if (key == "rule") pat.rule = value;
+            }
+            continue;
+        }
+        for (char ch : line) {
+            int n = max(run, 1);
+            if (isdigit((unsigned char)ch)) {
+                run = run * 10 + (ch - '0');
+                continue;
+            }
+            if (ch == '!') {
+                done = true;
+                break;
             }
-    return cnt;
+            if (ch == '$') {
+                y += n;
+                x = 0;
+            } else if (ch == 'b' || ch == '.') {
+                x += n;
+            } else if (isalpha((unsigned char)ch)) {
+                for (int i = 0; i < n; i++) pat.cells.push_back({x + i, y});
+                x += n;
+                pat.width = max(pat.width, x);
+                pat.height = max(pat.height, y + 1);
+            } else {
+                continue;   // whitespace between runs
+            }
+            run = 0;
+        }
+    }
+    if (pat.cells.empty()) {
+        cerr << path << " holds no live cells\n";
+        return false;
+    }
+    return true;
 }
 
-void randomizeGrid(vector<vector<char>> &grid) {
-    for (auto& row : grid)
-        for (char &cell : row)
-            cell = (rand() % 4 == 0) ? LIVE : DEAD;  // ~25% chance of being alive
+// Draws frames of a fixed-size view. The first frame is drawn in full; after
+// that only cells that differ from what is on screen are rewritten, each
+// reached with a cursor-addressing escape. The whole frame is built in one
+// buffer and written at once.
+class Renderer {
+public:
+    Renderer(int w, int h) : w(w), h(h), shown((size_t)w * h, 0) {}
+
+    void draw(const LifeEngine& engine, const string& header) {
+        buf.clear();
+        if (first) {
+            buf += "\033[2J";   // ANSI clear screen, understood by most terminals
+            first = false;
+            for (int y = 0; y < h; y++) {
+                moveTo(y + 2, 1);
+                for (int x = 0; x < w; x++) {
+                    char& cell = shown[(size_t)y * w + x];
+                    cell = engine.alive(x - w / 2, y - h / 2);
+                    buf += cell ? LIVE : DEAD;
+                    buf += ' ';
+                }
+            }
+        } else {
+            int row = 0, col = 0;   // where the cursor is, to skip needless moves
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++) {
+                    char& cell = shown[(size_t)y * w + x];
+                    char now = engine.alive(x - w / 2, y - h / 2);
+                    if (now == cell) continue;
+                    cell = now;
+                    if (row != y + 2 || col != 2 * x + 1) moveTo(y + 2, 2 * x + 1);
+                    buf += now ? LIVE : DEAD;
+                    buf += ' ';
+                    row = y + 2;
+                    col = 2 * x + 3;
+                }
+        }
+        moveTo(1, 1);
+        buf += header;
+        buf += "\033[K";   // erase what is left of a longer previous header
+        moveTo(h + 2, 1);
+        cout.write(buf.data(), buf.size());
+        cout.flush();
+    }
+
+private:
+    void moveTo(int row, int col) {
+        char esc[24];
+        buf.append(esc, snprintf(esc, sizeof(esc), "\033[%d;%dH", row, col));
+    }
+
+    int w, h;
+    vector<char> shown;   // what the terminal currently shows
+    string buf;
+    bool first = true;
+};
+
+// Headless run: no drawing and no delay, only the engine. Cells per second
+// count the width x height region, so it compares engines on the same board.
+void runBenchmark(LifeEngine& engine, int frames, int stepExp, int width, int height, uint64_t seed) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) engine.advance(stepExp);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double gens = (double)frames * (double)(1ULL << stepExp);
+    cout << engine.status() << "\n";
+    cout << width << "x" << height << ", seed " << seed << ", " << (unsigned long long)gens << " generations in "
+         << fixed << setprecision(3) << secs << " s\n";
+    cout << setprecision(1) << "generations/s: " << gens / secs << "\n";
+    cout << scientific << setprecision(3) << "cells/s:       " << gens * width * height / secs << "\n";
+    cout << "population:    " << engine.population() << "\n";
 }
 
-int main() {
-    srand(time(0));
-    vector<vector<char>> grid(HEIGHT, vector<char>(WIDTH, DEAD));
-    vector<vector<char>> nextGrid = grid;
+int main(int argc, char* argv[]) {
+    int width = 20, height = 15, stepExp = 0, hashlifeMb = 256;
+    int threads = max(1, (int)thread::hardware_concurrency()), delayMs = 400, benchFrames = 0;
+    uint64_t seed = (uint64_t)time(0);
+    string engineName = "bitboard", patternPath, ruleText, topology = "bounded";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--width=", 0) == 0) width = max(1, atoi(arg.c_str() + 8));
+        else if (arg.rfind("--height=", 0) == 0) height = max(1, atoi(arg.c_str() + 9));
+        else if (arg.rfind("--engine=", 0) == 0) engineName = arg.substr(9);
+        else if (arg.rfind("--pattern=", 0) == 0) patternPath = arg.substr(10);
+        else if (arg.rfind("--step-exp=", 0) == 0)
+            stepExp = min(HashLife::MAX_STEP_EXP, max(0, atoi(arg.c_str() + 11)));
+        else if (arg.rfind("--hashlife-mb=", 0) == 0) hashlifeMb = max(1, atoi(arg.c_str() + 14));
+        else if (arg.rfind("--threads=", 0) == 0) threads = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--seed=", 0) == 0) seed = strtoull(arg.c_str() + 7, nullptr, 10);
+        else if (arg.rfind("--delay-ms=", 0) == 0) delayMs = max(0, atoi(arg.c_str() + 11));
+        else if (arg.rfind("--rule=", 0) == 0) ruleText = arg.substr(7);
+        else if (arg.rfind("--topology=", 0) == 0) topology = arg.substr(11);
+        else if (arg == "--bench" || arg.rfind("--bench=", 0) == 0)
+            benchFrames = arg.size() > 8 ? max(1, atoi(arg.c_str() + 8)) : 1000;
+        else {
+            cerr << "Usage: " << argv[0] << " [--engine=bitboard|hashlife] [--width=N] [--height=N]"
+                 << " [--pattern=FILE.rle] [--step-exp=N] [--hashlife-mb=N] [--threads=N] [--seed=N]"
+                 << " [--delay-ms=N] [--rule=RULE] [--topology=bounded|wrap] [--bench[=FRAMES]]\n";
+            return 1;
+        }
+    }
+    if (engineName != "bitboard" && engineName != "hashlife") {
+        cerr << "Unknown engine '" << engineName << "' (use bitboard or hashlife)\n";
+        return 1;
+    }
+    if (topology != "bounded" && topology != "wrap") {
+        cerr << "Unknown topology '" << topology << "' (use bounded or wrap)\n";
+        return 1;
+    }
+    if (topology == "wrap" && engineName == "hashlife") {
+        cerr << "The hashlife universe is unbounded; --topology=wrap needs --engine=bitboard\n";
+        return 1;
+    }
+
+    Pattern pattern;
+    if (!patternPath.empty()) {
+        if (!loadRle(patternPath, pattern)) return 1;
+        // --rule wins over the file's rule. A Golly ":T40,30"-style grid
+        // suffix is dropped; --topology and the board size set the grid.
+        size_t colon = pattern.rule.find(':');
+        if (colon != string::npos) {
+            cerr << "Ignoring grid suffix " << pattern.rule.substr(colon) << " of the pattern's rule\n";
+            pattern.rule.erase(colon);
+        }
+        if (ruleText.empty()) ruleText = pattern.rule;
+        // A bounded board grows to hold the whole pattern
+        width = max(width, pattern.width + 2);
+        height = max(height, pattern.height + 2);
+    }
+
+    LifeRule rule;
+    if (!ruleText.empty() && !parseRule(ruleText, rule)) {
+        cerr << "Bad rule '" << ruleText << "' (use Bxx/Sxx without B0, xx/xx, or a name such as highlife,"
+             << " seeds, daynight)\n";
+        return 1;
+    }
+
+    unique_ptr<LifeEngine> engine;
+    int viewW = VIEW_WIDTH, viewH = VIEW_HEIGHT;
+    if (engineName == "hashlife") {
+        engine = make_unique<HashLifeEngine>((size_t)hashlifeMb << 20, rule);
+    } else {
+        engine = make_unique<BitBoardEngine>(width, height, threads, rule, topology == "wrap");
+        viewW = min(width, VIEW_WIDTH);
+        viewH = min(height, VIEW_HEIGHT);
+    }
+    if (pattern.cells.empty()) {
+        engine->randomize(width, height, seed);
+    } else {
+        for (auto& cell : pattern.cells)
+            engine->setCell(cell.first - pattern.width / 2, cell.second - pattern.height / 2);
+    }
 
-    randomizeGrid(grid);
+    if (benchFrames) {
+        runBenchmark(*engine, benchFrames, stepExp, width, height, seed);
+        return 0;
+    }
 
-    cout << "--- Conway's Game of Life ---\n";
+    cout << "--- Game of Life (" << rule.toString() << ") ---\n";
     cout << "Press Ctrl+C to stop\n";
-    int gen = 0;
+    unsigned long long gen = 0;
+    Renderer renderer(viewW, viewH);
 
     while (true) {
-        clearScreen();
-        cout << "Generation: " << ++gen << "\n";
-        printGrid(grid);
-
-        // Compute next generation
-        for (int y = 0; y < HEIGHT; ++y) {
-            for (int x = 0; x < WIDTH; ++x) {
-                int live = countLiveNeighbours(grid, x, y);
-                if (grid[y][x] == LIVE) {
-                    nextGrid[y][x] = (live == 2 || live == 3) ? LIVE : DEAD;
-                } else {
-                    nextGrid[y][x] = (live == 3) ? LIVE : DEAD;
-                }
-            }
-        }
-        grid.swap(nextGrid);
-        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        renderer.draw(*engine, "Generation: " + to_string(gen) + "  (" + engine->status() + ", " +
+                                   to_string(engine->population()) + " alive)");
+        engine->advance(stepExp);
+        gen += 1ULL << stepExp;
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
     }
     return 0;
 }
@@ -0,0 +1,194 @@
+#pragma once
+// Bounded LRU cache of open file descriptors plus their stat metadata.
+// A hit inside the revalidation window costs no syscalls at all, so serving a
+// hot file is just the send/sendfile. Missing paths are remembered in a
+// separate, smaller LRU, which keeps repeated 404s and probes for optional
+// siblings off the filesystem without letting a stream of unique misses evict
+// open files. Opens and stats run outside the lock.
+// Entries are handed out as shared_ptr so a descriptor evicted while a
+// response is still streaming from it stays open until that response finishes.
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+struct OpenFile {
+    int fd = -1;
+    long long size = 0;
+    time_t mtime = 0;
+    std::string contentType;
+    std::chrono::steady_clock::time_point checkedAt;
+
+    ~OpenFile() {
+        if (fd >= 0) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+    }
+};
+
+// Positional read that does not move a shared file offset, so several
+// connections can stream from the same cached descriptor at once.
+inline long long readAt(int fd, char* buf, size_t len, long long offset) {
+#ifdef _WIN32
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD got = 0;
+    if (!ReadFile(h, buf, (DWORD)len, &got, &ov)) return -1;
+    return got;
+#else
+    return pread(fd, buf, len, offset);
+#endif
+}
+
+inline std::string contentTypeFor(const std::string& path) {
+    static const std::unordered_map<std::string, std::string> types = {
+        {"html", "text/html"}, {"htm", "text/html"}, {"css", "text/css"},
+        {"js", "application/javascript"}, {"json", "application/json"},
+        {"txt", "text/plain"}, {"xml", "application/xml"}, {"svg", "image/svg+xml"},
+        {"png", "image/png"}, {"jpg", "image/jpeg"}, {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"}, {"ico", "image/x-icon"}, {"webp", "image/webp"},
+        {"mp4", "video/mp4"}, {"webm", "video/webm"}, {"mp3", "audio/mpeg"},
+        {"pdf", "application/pdf"}, {"wasm", "application/wasm"},
+    };
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos) {
+        auto it = types.find(path.substr(dot + 1));
+        if (it != types.end()) return it->second;
+    }
+    return "application/octet-stream";
+}
+
+class FileCache {
+public:
+    FileCache(size_t capacity, size_t missCapacity, std::chrono::milliseconds revalidateAfter)
+        : capacity(capacity), missCapacity(missCapacity), revalidateAfter(revalidateAfter) {}
+
+    // Returns the open file for path, or nullptr if it does not exist or is
+    // not a regular file.
+    std::shared_ptr<OpenFile> get(const std::string& path) {
+        auto now = std::chrono::steady_clock::now();
+        std::shared_ptr<OpenFile> cached;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = index.find(path);
+            if (it != index.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                cached = it->second->second;
+                if (now - cached->checkedAt < revalidateAfter) return cached;
+            } else {
+                auto miss = missIndex.find(path);
+                if (miss != missIndex.end()) {
+                    missLru.splice(missLru.begin(), missLru, miss->second);
+                    if (now - miss->second->second < revalidateAfter) return nullptr;
+                }
+            }
+        }
+
+        // Past the revalidation window or not cached: the filesystem is
+        // consulted without the lock, so other threads' hits never wait on it
+        if (cached) {
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG && st.st_mtime == cached->mtime &&
+                st.st_size == cached->size) {
+                std::lock_guard<std::mutex> lock(mtx);
+                cached->checkedAt = now;
+                return cached;
+            }
+        }
+        std::shared_ptr<OpenFile> file = openFile(path, now);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = index.find(path);
+        if (!file) {
+            if (it != index.end()) {   // removed on disk
+                lru.erase(it->second);
+                index.erase(it);
+            }
+            rememberMiss(path, now);
+            return nullptr;
+        }
+        auto miss = missIndex.find(path);
+        if (miss != missIndex.end()) {
+            missLru.erase(miss->second);
+            missIndex.erase(miss);
+        }
+        if (it != index.end()) {
+            // Changed on disk, or another thread opened it meanwhile; either way ours is current
+            it->second->second = file;
+            lru.splice(lru.begin(), lru, it->second);
+            return file;
+        }
+        lru.emplace_front(path, file);
+        index[path] = lru.begin();
+        if (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+        return file;
+    }
+
+private:
+    // Null if path cannot be served.
+    static std::shared_ptr<OpenFile> openFile(const std::string& path,
+                                              std::chrono::steady_clock::time_point now) {
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+        if (fd < 0) return nullptr;
+        auto file = std::make_shared<OpenFile>();
+        file->fd = fd;
+        file->checkedAt = now;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) return nullptr;   // closes fd
+        file->size = st.st_size;
+        file->mtime = st.st_mtime;
+        file->contentType = contentTypeFor(path);
+        return file;
+    }
+
+    // Requires mtx.
+    void rememberMiss(const std::string& path, std::chrono::steady_clock::time_point now) {
+        auto miss = missIndex.find(path);
+        if (miss != missIndex.end()) {
+            miss->second->second = now;
+            missLru.splice(missLru.begin(), missLru, miss->second);
+            return;
+        }
+        missLru.emplace_front(path, now);
+        missIndex[path] = missLru.begin();
+        if (missLru.size() > missCapacity) {
+            missIndex.erase(missLru.back().first);
+            missLru.pop_back();
+        }
+    }
+
+    using Entry = std::pair<std::string, std::shared_ptr<OpenFile>>;
+    using Miss = std::pair<std::string, std::chrono::steady_clock::time_point>;   // last confirmed missing
+    size_t capacity;
+    size_t missCapacity;
+    std::chrono::milliseconds revalidateAfter;
+    std::mutex mtx;
+    std::list<Entry> lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::list<Miss> missLru;
+    std::unordered_map<std::string, std::list<Miss>::iterator> missIndex;
+};
@@ -0,0 +1,151 @@
+#pragma once
+// Incremental, zero-copy HTTP/1.x request parser.
+// The parser never copies: every field of HttpRequest is a string_view into
+// the caller's receive buffer, so the request is only valid until that buffer
+// is modified. Feed it the whole unconsumed buffer after each read; it
+// remembers how far it already scanned so headers split across many reads
+// are not rescanned from the start.
+
+#include <cstddef>
+#include <string_view>
+
+enum class ParseStatus { Incomplete, Complete, Error };
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) return false;
+    }
+    return true;
+}
+
+// True if the comma-separated header value contains token (case-insensitive).
+inline bool headerHasToken(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (equalsIgnoreCase(item, token)) return true;
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+struct HttpRequest {
+    static const size_t MAX_HEADERS = 64;
+
+    std::string_view method;
+    std::string_view target;
+    std::string_view version;
+    HttpHeader headers[MAX_HEADERS];
+    size_t headerCount = 0;
+    size_t length = 0;        // bytes of the buffer this request occupies (head + body)
+    bool keepAlive = false;
+    int errorStatus = 0;      // HTTP status to answer with when parsing fails
+
+    std::string_view header(std::string_view name) const {
+        for (size_t i = 0; i < headerCount; ++i)
+            if (equalsIgnoreCase(headers[i].name, name)) return headers[i].value;
+        return {};
+    }
+};
+
+class HttpParser {
+public:
+    static const size_t MAX_HEAD_SIZE = 16 * 1024;
+    static const size_t MAX_BODY_SIZE = 1024 * 1024;
+
+    // Parses the request at the start of buf. On Complete, req.length bytes
+    // belong to the request; consume them and call reset() before the next one.
+    ParseStatus parse(std::string_view buf, HttpRequest& req) {
+        if (headEnd == 0) {
+            size_t from = scanned >= 3 ? scanned - 3 : 0;
+            size_t end = buf.find("\r\n\r\n", from);
+            if (end == std::string_view::npos) {
+                scanned = buf.size();
+                if (buf.size() > MAX_HEAD_SIZE) return fail(req, 431);
+                return ParseStatus::Incomplete;
+            }
+            if (end + 4 > MAX_HEAD_SIZE) return fail(req, 431);
+            headEnd = end + 4;
+        }
+        ParseStatus status = parseHead(buf.substr(0, headEnd - 2), req);
+        if (status != ParseStatus::Complete) return status;
+        if (buf.size() < headEnd + bodyLength) return ParseStatus::Incomplete;
+        req.length = headEnd + bodyLength;
+        return ParseStatus::Complete;
+    }
+
+    void reset() {
+        scanned = 0;
+        headEnd = 0;
+        bodyLength = 0;
+    }
+
+private:
+    ParseStatus fail(HttpRequest& req, int status) {
+        req.errorStatus = status;
+        req.keepAlive = false;
+        return ParseStatus::Error;
+    }
+
+    // head is the request line and header lines, each terminated by CRLF.
+    ParseStatus parseHead(std::string_view head, HttpRequest& req) {
+        req.headerCount = 0;
+        size_t eol = head.find("\r\n");
+        std::string_view line = head.substr(0, eol);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+        if (sp2 == std::string_view::npos) return fail(req, 400);
+        req.method = line.substr(0, sp1);
+        req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        req.version = line.substr(sp2 + 1);
+        if (req.method.empty() || req.target.empty() || req.version.substr(0, 5) != "HTTP/")
+            return fail(req, 400);
+
+        head.remove_prefix(eol + 2);
+        while (!head.empty()) {
+            eol = head.find("\r\n");
+            line = head.substr(0, eol);
+            head.remove_prefix(eol + 2);
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0) return fail(req, 400);
+            if (req.headerCount == HttpRequest::MAX_HEADERS) return fail(req, 431);
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+            req.headers[req.headerCount++] = {line.substr(0, colon), value};
+        }
+
+        std::string_view connection = req.header("Connection");
+        if (req.version == "HTTP/1.1")
+            req.keepAlive = !headerHasToken(connection, "close");
+        else
+            req.keepAlive = headerHasToken(connection, "keep-alive");
+
+        // We never accept chunked uploads; without a length the body cannot be framed.
+        if (!req.header("Transfer-Encoding").empty()) return fail(req, 501);
+        std::string_view contentLength = req.header("Content-Length");
+        bodyLength = 0;
+        for (char c : contentLength) {
+            if (c < '0' || c > '9') return fail(req, 400);
+            bodyLength = bodyLength * 10 + (c - '0');
+            if (bodyLength > MAX_BODY_SIZE) return fail(req, 413);
+        }
+        return ParseStatus::Complete;
+    }
+
+    size_t scanned = 0;       // bytes already searched for the end of the head
+    size_t headEnd = 0;       // offset just past the blank line, 0 while unknown
+    size_t bodyLength = 0;
+};
@@ -0,0 +1,126 @@
+#pragma once
+// Minimal io_uring wrapper on the raw syscalls (no liburing dependency).
+// Linux 5.6+ for the accept/recv/send/read opcodes used by the server.
+//
+// Usage: grab SQEs with getSqe(), fill them in, then submitAndWait() hands
+// every prepared SQE to the kernel in a single io_uring_enter and optionally
+// waits for completions, which forEachCompletion() then drains.
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    // Returns false (with errno set) if the kernel refuses io_uring.
+    bool init(unsigned entries) {
+        io_uring_params params = {};
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0) return false;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+        if (!sqRing) return false;
+        cqRing = singleMmap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+        if (!cqRing) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map(sqesSize, IORING_OFF_SQES));
+        if (!sqes) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+        return true;
+    }
+
+    // Next free submission slot, zeroed; nullptr when the queue is full
+    // (submit what is prepared and try again).
+    io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= sqEntries) return nullptr;
+        unsigned idx = localTail & sqMask;
+        sqArray[idx] = idx;
+        localTail++;
+        io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Publishes prepared SQEs and enters the kernel once, waiting for at least
+    // waitFor completions. Returns the io_uring_enter result.
+    int submitAndWait(unsigned waitFor) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        // Everything the kernel has not consumed yet, including leftovers of a short submit
+        unsigned toSubmit = localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (toSubmit == 0 && waitFor == 0) return 0;
+        int ret;
+        do {
+            ret = (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor,
+                               waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        } while (ret < 0 && errno == EINTR && waitFor == 0);
+        enterCount++;
+        return ret;
+    }
+
+    template <typename F>
+    unsigned forEachCompletion(F handle) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned seen = 0;
+        while (head != tail) {
+            io_uring_cqe cqe = cqes[head & cqMask];
+            head++;
+            seen++;
+            // Release the slot before handling so handlers can queue more work
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            handle(cqe);
+        }
+        return seen;
+    }
+
+    unsigned long long enters() const { return enterCount; }
+
+private:
+    void* map(size_t size, off_t offset) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr;
+    unsigned sqMask = 0, sqEntries = 0;
+    unsigned *cqHead = nullptr, *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned localTail = 0;
+    unsigned long long enterCount = 0;
+};
@@ -0,0 +1,219 @@
+#pragma once
+// Low-overhead request instrumentation.
+// Every thread records into its own ThreadMetrics, so the hot path is a few
+// relaxed loads and stores with no locks and no shared cache lines. Readers
+// take the registry lock and sum all live threads plus the totals left behind
+// by threads that already exited (thread-per-connection mode retires a
+// ThreadMetrics with every connection).
+//
+// Histograms are HDR-style log-linear: values are bucketed by their highest
+// set bit and the next SUB_BITS bits, which keeps relative error under ~6%
+// from nanoseconds to minutes in a fixed, small array.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int highestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+class Histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static int bucketFor(uint64_t v) {
+        if (v < SUB_BUCKETS) return (int)v;
+        int msb = highestBit(v);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + (int)((v >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Smallest value that would land in the bucket after b.
+    static uint64_t upperBound(int b) {
+        if (b < SUB_BUCKETS) return b + 1;
+        int shift = b / SUB_BUCKETS - 1;
+        uint64_t sub = b % SUB_BUCKETS;
+        return (SUB_BUCKETS + sub + 1) << shift;
+    }
+
+    // Single writer: only the owning thread records, so no read-modify-write is needed.
+    void record(uint64_t v) {
+        std::atomic<uint64_t>& c = counts[bucketFor(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> sum{0};
+};
+
+// Plain copy of one or more merged histograms.
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts = std::vector<uint64_t>(Histogram::BUCKETS, 0);
+    uint64_t sum = 0;
+
+    void add(const Histogram& h) {
+        for (int b = 0; b < Histogram::BUCKETS; ++b) counts[b] += h.counts[b].load(std::memory_order_relaxed);
+        sum += h.sum.load(std::memory_order_relaxed);
+    }
+
+    void add(const HistogramSnapshot& other) {
+        for (int b = 0; b < Histogram::BUCKETS; ++b) counts[b] += other.counts[b];
+        sum += other.sum;
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (uint64_t c : counts) total += c;
+        return total;
+    }
+
+    // Upper bound of the bucket holding quantile q.
+    uint64_t quantile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (total - 1)) + 1, seen = 0;
+        for (int b = 0; b < Histogram::BUCKETS; ++b) {
+            seen += counts[b];
+            if (seen >= rank) return Histogram::upperBound(b);
+        }
+        return Histogram::upperBound(Histogram::BUCKETS - 1);
+    }
+
+    // Count of values below limit (exact at bucket edges, else within one bucket).
+    uint64_t countBelow(uint64_t limit) const {
+        uint64_t total = 0;
+        for (int b = 0; b < Histogram::BUCKETS && Histogram::upperBound(b) <= limit; ++b) total += counts[b];
+        return total;
+    }
+};
+
+enum MetricId { AcceptToFirstByte, ParseTime, BuildTime, SendTime, METRIC_COUNT };
+
+struct ThreadMetrics {
+    Histogram histograms[METRIC_COUNT];
+    std::atomic<uint64_t> bytesSent{0};
+    std::atomic<uint64_t> responses[6] = {};   // by status class, index 1..5
+    std::atomic<uint64_t> rejected{0};         // connections turned away with a 503
+    std::atomic<uint64_t> reactorSyscalls{0};  // epoll/io_uring reactor system calls
+
+    void add(std::atomic<uint64_t>& counter, uint64_t v) {
+        counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+};
+
+struct MetricsSnapshot {
+    HistogramSnapshot histograms[METRIC_COUNT];
+    uint64_t bytesSent = 0;
+    uint64_t responses[6] = {};
+    uint64_t rejected = 0;
+    uint64_t reactorSyscalls = 0;
+
+    void add(const ThreadMetrics& t) {
+        for (int m = 0; m < METRIC_COUNT; ++m) histograms[m].add(t.histograms[m]);
+        bytesSent += t.bytesSent.load(std::memory_order_relaxed);
+        for (int i = 0; i < 6; ++i) responses[i] += t.responses[i].load(std::memory_order_relaxed);
+        rejected += t.rejected.load(std::memory_order_relaxed);
+        reactorSyscalls += t.reactorSyscalls.load(std::memory_order_relaxed);
+    }
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    // The calling thread's metrics, registered on first use.
+    static ThreadMetrics& local() {
+        thread_local Registration registration;
+        return *registration.metrics;
+    }
+
+    MetricsSnapshot snapshot() {
+        std::lock_guard<std::mutex> lock(mtx);
+        MetricsSnapshot snap;
+        for (int m = 0; m < METRIC_COUNT; ++m) snap.histograms[m].add(retired.histograms[m]);
+        snap.bytesSent = retired.bytesSent;
+        for (int i = 0; i < 6; ++i) snap.responses[i] = retired.responses[i];
+        snap.rejected = retired.rejected;
+        snap.reactorSyscalls = retired.reactorSyscalls;
+        for (const auto& t : live) snap.add(*t);
+        return snap;
+    }
+
+private:
+    struct Registration {
+        std::shared_ptr<ThreadMetrics> metrics = std::make_shared<ThreadMetrics>();
+        Registration() {
+            MetricsRegistry& r = instance();
+            std::lock_guard<std::mutex> lock(r.mtx);
+            r.live.push_back(metrics);
+        }
+        ~Registration() {
+            MetricsRegistry& r = instance();
+            std::lock_guard<std::mutex> lock(r.mtx);
+            r.retired.add(*metrics);
+            for (size_t i = 0; i < r.live.size(); ++i) {
+                if (r.live[i] == metrics) {
+                    r.live[i] = r.live.back();
+                    r.live.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    std::mutex mtx;
+    std::vector<std::shared_ptr<ThreadMetrics>> live;
+    MetricsSnapshot retired;
+};
+
+inline uint64_t elapsedNanos(std::chrono::steady_clock::time_point since) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - since).count();
+}
+
+// Prometheus text exposition of one latency histogram (recorded in ns, exported in seconds).
+inline void writePrometheusHistogram(std::string& out, const char* name, const char* help,
+                                     const HistogramSnapshot& h) {
+    static const uint64_t boundsNs[] = {
+        1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+        1000000, 2000000, 5000000, 10000000, 20000000, 50000000, 100000000,
+        200000000, 500000000, 1000000000, 2000000000, 5000000000, 10000000000};
+    char line[256];
+    out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " histogram\n";
+    for (uint64_t bound : boundsNs) {
+        snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name, bound / 1e9,
+                 (unsigned long long)h.countBelow(bound));
+        out += line;
+    }
+    unsigned long long count = h.count();
+    snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n%s_count %llu\n",
+             name, count, name, h.sum / 1e9, name, count);
+    out += line;
+    // Tail quantiles straight from the fine-grained buckets, for quick reads without PromQL
+    out += std::string("# TYPE ") + name + "_quantile gauge\n";
+    for (double q : {0.5, 0.99, 0.999}) {
+        snprintf(line, sizeof(line), "%s_quantile{quantile=\"%g\"} %.9f\n", name, q, h.quantile(q) / 1e9);
+        out += line;
+    }
+}
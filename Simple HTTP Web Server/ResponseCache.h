@@ -0,0 +1,118 @@
+#pragma once
+// Size-bounded LRU cache of fully formed responses, keyed by the file that
+// produced them. An entry remembers the mtime and size of its source so the
+// caller can drop it as soon as the file changes on disk. The cache is split
+// into independently locked shards so reactor threads rarely contend.
+
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct CachedResponse {
+    std::string head;                       // status line and headers, without Connection or the blank line
+    std::shared_ptr<const std::string> body;
+    time_t mtime = 0;                       // source file metadata the entry was built from
+    long long size = 0;
+
+    size_t footprint() const { return head.size() + body->size(); }
+};
+
+class ResponseCache {
+public:
+    static const size_t SHARDS = 16;
+
+    ResponseCache(size_t capacityBytes, size_t maxEntryBytes)
+        : maxEntryBytes(maxEntryBytes), shardCapacity(capacityBytes / SHARDS) {}
+
+    // Returns the entry for key if it was built from a file with this mtime
+    // and size; a stale entry is evicted. Counts a hit or a miss.
+    std::shared_ptr<const CachedResponse> get(const std::string& key, time_t mtime, long long size) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            const auto& entry = it->second->second;
+            if (entry->mtime == mtime && entry->size == size) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                hitCount.fetch_add(1, std::memory_order_relaxed);
+                return entry;
+            }
+            shard.bytes -= entry->footprint();
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void put(const std::string& key, std::shared_ptr<const CachedResponse> entry) {
+        size_t bytes = entry->footprint();
+        if (bytes > maxEntryBytes || bytes > shardCapacity) return;
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.bytes -= it->second->second->footprint();
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        shard.lru.emplace_front(key, std::move(entry));
+        shard.index[key] = shard.lru.begin();
+        shard.bytes += bytes;
+        while (shard.bytes > shardCapacity) {
+            shard.bytes -= shard.lru.back().second->footprint();
+            shard.index.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+            evictionCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool fits(long long bytes) const { return bytes >= 0 && (size_t)bytes <= maxEntryBytes; }
+
+    unsigned long long hits() const { return hitCount.load(std::memory_order_relaxed); }
+    unsigned long long misses() const { return missCount.load(std::memory_order_relaxed); }
+    unsigned long long evictions() const { return evictionCount.load(std::memory_order_relaxed); }
+
+    size_t bytesUsed() {
+        size_t total = 0;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            total += shard.bytes;
+        }
+        return total;
+    }
+
+    size_t entries() {
+        size_t total = 0;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            total += shard.index.size();
+        }
+        return total;
+    }
+
+    size_t capacity() const { return shardCapacity * SHARDS; }
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const CachedResponse>>;
+    struct Shard {
+        std::mutex mtx;
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shardFor(const std::string& key) { return shards[std::hash<std::string>()(key) % SHARDS]; }
+
+    size_t maxEntryBytes;
+    size_t shardCapacity;
+    Shard shards[SHARDS];
+    std::atomic<unsigned long long> hitCount{0};
+    std::atomic<unsigned long long> missCount{0};
+    std::atomic<unsigned long long> evictionCount{0};
+};
@@ -0,0 +1,345 @@
+// bench.cpp - load generator for the Simple HTTP Web Server (Linux, epoll)
+//
+// Usage: bench [--port=N] [--host=IP] [--connections=N] [--threads=N] [--duration=SECONDS]
+//              [--keep-alive=1|0] [--path=/file] [--scenario=small|large|404|all]
+//        bench --prepare=DIR   writes the scenario fixture files into DIR
+//
+// Every connection issues one request at a time; latency is measured from the
+// first byte of the request to the last byte of the response (including the
+// TCP handshake when keep-alive is off). --scenario=all runs the small file,
+// 10 MB file and 404 storm scenarios with and without keep-alive so runs can
+// be compared line by line.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct BenchConfig {
+    string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 64;
+    int threads = 1;
+    int durationSeconds = 10;
+    bool keepAlive = true;
+    string path = "/";
+    bool uniquePaths = false;   // 404 storm: a different missing path per request
+};
+
+struct BenchResult {
+    unsigned long long requests = 0;
+    unsigned long long non2xx = 0;
+    unsigned long long errors = 0;
+    unsigned long long bytes = 0;
+    vector<uint32_t> latenciesUs;
+    double seconds = 0;
+};
+
+enum class ClientState { Connecting, Sending, ReadingHead, ReadingBody };
+
+struct Client {
+    int fd = -1;
+    ClientState state = ClientState::Connecting;
+    string request;
+    size_t sent = 0;
+    string head;
+    long long bodyLeft = -1;        // -1: no Content-Length, read until close
+    int status = 0;
+    Clock::time_point start;
+};
+
+class Worker {
+public:
+    Worker(const BenchConfig& cfg, int connections, int id) : cfg(cfg), id(id), clients(connections) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(cfg.port);
+        inet_pton(AF_INET, cfg.host.c_str(), &addr.sin_addr);
+    }
+
+    ~Worker() {
+        for (Client& c : clients)
+            if (c.fd >= 0) close(c.fd);
+        close(epfd);
+    }
+
+    void run(Clock::time_point deadline) {
+        for (Client& c : clients) startRequest(c, true);
+        epoll_event events[512];
+        while (Clock::now() < deadline) {
+            vector<Client*> pending;
+            pending.swap(retry);
+            for (Client* c : pending) startRequest(*c, true);
+            int n = epoll_wait(epfd, events, 512, 50);
+            for (int i = 0; i < n; ++i) {
+                Client& c = *static_cast<Client*>(events[i].data.ptr);
+                if (events[i].events & EPOLLERR) {
+                    fail(c);
+                    continue;
+                }
+                if (c.state == ClientState::Connecting) c.state = ClientState::Sending;
+                if (c.state == ClientState::Sending) onWritable(c);
+                if (c.state == ClientState::ReadingHead || c.state == ClientState::ReadingBody) onReadable(c);
+            }
+        }
+    }
+
+    BenchResult result;
+
+private:
+    // Opens a socket when needed and queues the next request.
+    void startRequest(Client& c, bool reconnect) {
+        c.request = "GET " + nextPath() + " HTTP/1.1\r\nHost: " + cfg.host + "\r\n" +
+                    (cfg.keepAlive ? "" : "Connection: close\r\n") + "\r\n";
+        c.sent = 0;
+        c.head.clear();
+        c.bodyLeft = -1;
+        c.status = 0;
+        c.start = Clock::now();
+        if (!reconnect) {
+            c.state = ClientState::Sending;
+            onWritable(c);
+            return;
+        }
+        if (c.fd >= 0) close(c.fd);
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.ptr = &c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+        c.state = ClientState::Connecting;
+        if (connect(c.fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+            c.state = ClientState::Sending;
+            onWritable(c);
+        } else if (errno != EINPROGRESS) {
+            result.errors++;
+            retry.push_back(&c);   // reconnect on the next loop iteration, not recursively
+        }
+    }
+
+    string nextPath() {
+        if (!cfg.uniquePaths) return cfg.path;
+        return cfg.path + to_string(id) + "-" + to_string(counter++);
+    }
+
+    void onWritable(Client& c) {
+        while (c.sent < c.request.size()) {
+            ssize_t n = send(c.fd, c.request.data() + c.sent, c.request.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.sent += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            fail(c);
+            return;
+        }
+        c.state = ClientState::ReadingHead;
+    }
+
+    void onReadable(Client& c) {
+        char buf[64 * 1024];
+        while (true) {
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n < 0 || (n == 0 && !(c.state == ClientState::ReadingBody && c.bodyLeft < 0))) {
+                fail(c);
+                return;
+            }
+            if (n == 0) {   // body delimited by close
+                complete(c, true);
+                return;
+            }
+            result.bytes += n;
+            size_t bodyLen = n;   // body bytes are only counted, never kept
+            if (c.state == ClientState::ReadingHead) {
+                c.head.append(buf, n);
+                size_t end = c.head.find("\r\n\r\n");
+                if (end == string::npos) continue;
+                parseHead(c, end);
+                bodyLen = c.head.size() - end - 4;
+                c.state = ClientState::ReadingBody;
+            }
+            if (c.bodyLeft >= 0) {
+                c.bodyLeft -= bodyLen;
+                if (c.bodyLeft <= 0) {
+                    complete(c, !cfg.keepAlive || c.head.find("Connection: close") != string::npos);
+                    return;
+                }
+            }
+        }
+    }
+
+    void parseHead(Client& c, size_t end) {
+        c.status = atoi(c.head.c_str() + 9);   // "HTTP/1.1 200"
+        size_t pos = c.head.find("Content-Length:");
+        c.bodyLeft = (pos != string::npos && pos < end) ? atoll(c.head.c_str() + pos + 15) : -1;
+        if (c.status == 304 || c.status / 100 == 1) c.bodyLeft = 0;
+    }
+
+    void complete(Client& c, bool reconnect) {
+        auto us = chrono::duration_cast<chrono::microseconds>(Clock::now() - c.start).count();
+        result.latenciesUs.push_back((uint32_t)min<long long>(us, UINT32_MAX));
+        result.requests++;
+        if (c.status / 100 != 2) result.non2xx++;
+        startRequest(c, reconnect);
+    }
+
+    void fail(Client& c) {
+        result.errors++;
+        startRequest(c, true);
+    }
+
+    const BenchConfig& cfg;
+    int id;
+    vector<Client> clients;
+    int epfd;
+    sockaddr_in addr = {};
+    unsigned long long counter = 0;
+    vector<Client*> retry;
+};
+
+BenchResult runBench(const BenchConfig& cfg) {
+    vector<unique_ptr<Worker>> workers;
+    for (int t = 0; t < cfg.threads; ++t) {
+        int share = cfg.connections / cfg.threads + (t < cfg.connections % cfg.threads ? 1 : 0);
+        workers.push_back(make_unique<Worker>(cfg, share, t));
+    }
+    auto start = Clock::now();
+    auto deadline = start + chrono::seconds(cfg.durationSeconds);
+    vector<thread> threads;
+    for (auto& w : workers) threads.emplace_back([&w, deadline]() { w->run(deadline); });
+    for (auto& t : threads) t.join();
+
+    BenchResult total;
+    total.seconds = chrono::duration<double>(Clock::now() - start).count();
+    for (auto& w : workers) {
+        total.requests += w->result.requests;
+        total.non2xx += w->result.non2xx;
+        total.errors += w->result.errors;
+        total.bytes += w->result.bytes;
+        total.latenciesUs.insert(total.latenciesUs.end(), w->result.latenciesUs.begin(), w->result.latenciesUs.end());
+    }
+    sort(total.latenciesUs.begin(), total.latenciesUs.end());
+    return total;
+}
+
+double percentileMs(const vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[idx] / 1000.0;
+}
+
+void printHeader() {
+    printf("%-8s %-5s %6s %10s %11s %9s %9s %9s %9s %8s %7s\n", "scenario", "keep", "conns", "requests",
+           "req/s", "MB/s", "p50 ms", "p99 ms", "p999 ms", "non-2xx", "errors");
+}
+
+void printResult(const string& name, const BenchConfig& cfg, const BenchResult& r) {
+    printf("%-8s %-5s %6d %10llu %11.1f %9.1f %9.3f %9.3f %9.3f %8llu %7llu\n", name.c_str(),
+           cfg.keepAlive ? "yes" : "no", cfg.connections, r.requests, r.requests / r.seconds,
+           r.bytes / r.seconds / (1 << 20), percentileMs(r.latenciesUs, 0.50),
+           percentileMs(r.latenciesUs, 0.99), percentileMs(r.latenciesUs, 0.999), r.non2xx, r.errors);
+    fflush(stdout);
+}
+
+// Fixture files the scenarios request; serve them from the server's directory.
+bool prepareFixtures(const string& dir) {
+    ofstream small(dir + "/bench_small.html", ios::binary);
+    string page = "<html><body>" + string(1000, 'x') + "</body></html>\n";
+    small << page;
+    ofstream large(dir + "/bench_10mb.bin", ios::binary);
+    string block(1 << 20, '\0');
+    for (size_t i = 0; i < block.size(); ++i) block[i] = (char)(i * 2654435761u >> 24);
+    for (int i = 0; i < 10; ++i) large.write(block.data(), block.size());
+    return small.good() && large.good();
+}
+
+bool applyScenario(const string& name, BenchConfig& cfg) {
+    if (name == "small") cfg.path = "/bench_small.html";
+    else if (name == "large") cfg.path = "/bench_10mb.bin";
+    else if (name == "404") {
+        cfg.path = "/bench_missing_";
+        cfg.uniquePaths = true;
+    } else return false;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    string scenario;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--prepare=", 0) == 0) {
+            string dir = arg.substr(10);
+            if (!prepareFixtures(dir)) {
+                cerr << "Could not write fixtures to " << dir << "\n";
+                return 1;
+            }
+            cout << "Wrote bench_small.html and bench_10mb.bin to " << dir << "\n";
+            return 0;
+        }
+        if (arg.rfind("--host=", 0) == 0) cfg.host = arg.substr(7);
+        else if (arg.rfind("--port=", 0) == 0) cfg.port = atoi(arg.c_str() + 7);
+        else if (arg.rfind("--connections=", 0) == 0) cfg.connections = max(1, atoi(arg.c_str() + 14));
+        else if (arg.rfind("--threads=", 0) == 0) cfg.threads = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--duration=", 0) == 0) cfg.durationSeconds = max(1, atoi(arg.c_str() + 11));
+        else if (arg.rfind("--keep-alive=", 0) == 0) cfg.keepAlive = atoi(arg.c_str() + 13) != 0;
+        else if (arg.rfind("--path=", 0) == 0) cfg.path = arg.substr(7);
+        else if (arg.rfind("--scenario=", 0) == 0) scenario = arg.substr(11);
+        else {
+            cerr << "Usage: " << argv[0] << " [--port=N] [--host=IP] [--connections=N] [--threads=N]"
+                 << " [--duration=SECONDS] [--keep-alive=1|0] [--path=/file]"
+                 << " [--scenario=small|large|404|all] | --prepare=DIR\n";
+            return 1;
+        }
+    }
+    cfg.threads = min(cfg.threads, cfg.connections);
+    signal(SIGPIPE, SIG_IGN);
+
+    printHeader();
+    if (scenario.empty()) {
+        printResult("custom", cfg, runBench(cfg));
+        return 0;
+    }
+    vector<string> names = scenario == "all" ? vector<string>{"small", "large", "404"} : vector<string>{scenario};
+    for (const string& name : names) {
+        BenchConfig run = cfg;
+        if (!applyScenario(name, run)) {
+            cerr << "Unknown scenario: " << name << "\n";
+            return 1;
+        }
+        if (scenario == "all") {
+            for (bool keepAlive : {true, false}) {
+                run.keepAlive = keepAlive;
+                printResult(name, run, runBench(run));
+            }
+        } else {
+            printResult(name, run, runBench(run));
+        }
+    }
+    return 0;
+}
@@ -1,12 +1,34 @@
 // main.cpp
+//
+// Usage: server [--mode=epoll|uring|threads|reuseport] [--reactors=N] [--port=N] [--idle-timeout=SECONDS]
+//               [--cache-mb=N] [--acceptors=N] [--workers=N] [--max-connections=N]
+//               [--read-timeout=SECONDS] [--write-timeout=SECONDS]
+//   epoll     - edge-triggered epoll reactors with non-blocking sockets (Linux, default)
+//   uring     - io_uring reactors batching accept/recv/send/file reads; falls back
+//               to epoll if the kernel refuses io_uring (Linux 5.6+)
+//   reuseport - one SO_REUSEPORT listener and accept loop per acceptor, each with
+//               a fixed worker pool and global admission control (Linux)
+//   threads   - one detached thread per connection (portable fallback)
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <cstring>
 #include <vector>
 #include <thread>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include <deque>
+#include <string_view>
+#include <sstream>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #ifdef _WIN32
 #include <winsock2.h>
 #pragma comment(lib,"ws2_32.lib")
@@ -14,10 +36,28 @@ typedef int socklen_t;
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
+#include <csignal>
 #define INVALID_SOCKET -1
 #define SOCKET int
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <cerrno>
+#else
+#define MSG_MORE 0
+#endif
+#include "FileCache.h"
+#include "HttpParser.h"
+#include "ResponseCache.h"
+#include "Metrics.h"
+#ifdef __linux__
+#include "IoUring.h"
+#endif
 
 using namespace std;
 
@@ -36,62 +76,1487 @@ void cleanupSockets() {
 #endif
 }
 
-void handle_client(SOCKET client) {
-    char buffer[1024] = {0};
-    int recvlen = recv(client, buffer, sizeof(buffer)-1, 0);
-    if (recvlen <= 0) {
-#ifdef _WIN32
-        closesocket(client);
-#else
-        close(client);
-#endif
-        return;
-    }
-    buffer[recvlen] = 0;
-    string req(buffer);
-    istringstream iss(req);
-    string method, path, proto;
-    iss >> method >> path >> proto;
-    if (method != "GET") {
-        string resp = "HTTP/1.0 501 Not Implemented\r\n\r\n";
-        send(client, resp.c_str(), resp.size(), 0);
+void closeSocket(SOCKET s) {
 #ifdef _WIN32
-        closesocket(client);
+    closesocket(s);
 #else
-        close(client);
+    close(s);
 #endif
-        return;
+}
+
+// Blocking send of the whole buffer; returns false if the peer went away.
+bool sendAll(SOCKET s, const char* data, size_t len, int flags = 0) {
+    while (len > 0) {
+        int n = send(s, data, (int)len, flags);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
     }
-    // Remove leading slash
-    string filename = path == "/" ? "index.html" : path.substr(1);
-    ifstream file(filename);
-    if (!file) {
-        string resp = "HTTP/1.0 404 Not Found\r\n\r\n<h1>404 Not Found</h1>";
-        send(client, resp.c_str(), resp.size(), 0);
+    return true;
+}
+
+// Hot files keep their descriptor and stat result cached, and up to 128
+// recent misses are remembered apart from them; the metadata is re-checked
+// at most once a second so edits on disk are still picked up.
+FileCache fileCache(256, 128, chrono::milliseconds(1000));
+
+// Small files are kept as ready-to-send responses; see ResponseCache.h.
+// Created in main() once the size limit is known.
+unique_ptr<ResponseCache> responseCache;
+
+// Idle keep-alive connections are closed after this long without traffic.
+int idleTimeoutSeconds = 15;
+// A request must arrive completely within readTimeoutSeconds of its first
+// byte, and a response may go writeTimeoutSeconds without the client taking
+// any of it (in the blocking modes: a single send may block that long).
+int readTimeoutSeconds = 10;
+int writeTimeoutSeconds = 30;
+
+// One piece of a response body: a slice of a shared in-memory buffer (a
+// cached body or a multipart boundary) or a range of a cached file that is
+// streamed straight from the page cache. Nothing is copied per connection, so
+// memory per response stays constant no matter how large the file is.
+struct BodySegment {
+    shared_ptr<const string> data;   // null for a file range
+    shared_ptr<OpenFile> file;
+    long long offset = 0;
+    long long length = 0;
+};
+
+// A response is an in-memory head (status line, headers and any small body)
+// followed by zero or more body segments.
+struct Response {
+    string head;
+    vector<BodySegment> body;
+    bool keepAlive = false;   // connection stays open once this is sent
+    int status = 200;
+    chrono::steady_clock::time_point sendStart;   // first byte written
+
+    long long bodyLength() const {
+        long long total = 0;
+        for (const BodySegment& seg : body) total += seg.length;
+        return total;
+    }
+};
+
+const char* reasonPhrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 408: return "Request Timeout";
+        case 206: return "Partial Content";
+        case 413: return "Payload Too Large";
+        case 416: return "Range Not Satisfiable";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+// Final header line plus the blank line that ends the head.
+const char* connectionHeader(bool keepAlive) {
+    return keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+}
+
+string statusHead(int status, const string& contentType, long long contentLength, bool keepAlive) {
+    string head = "HTTP/1.1 " + to_string(status) + " " + reasonPhrase(status) + "\r\n";
+    if (!contentType.empty()) head += "Content-Type: " + contentType + "\r\n";
+    head += "Content-Length: " + to_string(contentLength) + "\r\n";
+    return head + connectionHeader(keepAlive);
+}
+
+Response errorResponse(int status, bool keepAlive) {
+    string body = "<h1>" + to_string(status) + " " + reasonPhrase(status) + "</h1>";
+    Response resp;
+    resp.keepAlive = keepAlive;
+    resp.status = status;
+    resp.head = statusHead(status, "text/html", body.size(), keepAlive) + body;
+    return resp;
+}
+
+string httpDate(time_t t) {
+    tm utc;
 #ifdef _WIN32
-        closesocket(client);
+    gmtime_s(&utc, &t);
 #else
-        close(client);
+    gmtime_r(&t, &utc);
 #endif
-        return;
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+    return buf;
+}
+
+// Strong validator derived from the file metadata, distinct per encoding.
+string makeETag(const OpenFile& file, const char* encoding) {
+    ostringstream tag;
+    tag << '"' << hex << (long long)file.mtime << '-' << file.size;
+    if (encoding) tag << '-' << encoding;
+    tag << '"';
+    return tag.str();
+}
+
+bool etagMatches(string_view ifNoneMatch, const string& etag) {
+    while (!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        string_view item = ifNoneMatch.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (item.substr(0, 2) == "W/") item.remove_prefix(2);
+        if (item == "*" || item == etag) return true;
+        if (comma == string_view::npos) break;
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// True if an Accept-Encoding value lists coding without q=0.
+bool acceptsEncoding(string_view acceptEncoding, string_view coding) {
+    while (!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        string_view item = acceptEncoding.substr(0, comma);
+        size_t semi = item.find(';');
+        string_view name = item.substr(0, semi);
+        while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+        while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+        if (equalsIgnoreCase(name, coding)) {
+            if (semi == string_view::npos) return true;
+            size_t q = item.find("q=", semi);
+            return q == string_view::npos || atof(string(item.substr(q + 2)).c_str()) > 0;
+        }
+        if (comma == string_view::npos) break;
+        acceptEncoding.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Byte ranges honoured per request; more than this (often overlapping ranges
+// used to amplify traffic) and the Range header is ignored.
+const size_t MAX_RANGES = 16;
+
+enum class RangeResult { None, Ok, Unsatisfiable };
+
+// Parses "bytes=a-b, c-, -n" into inclusive [first, last] ranges clipped to
+// size. Malformed headers and other units yield None (serve the whole file).
+RangeResult parseRanges(string_view header, long long size, vector<pair<long long, long long>>& ranges) {
+    ranges.clear();
+    if (header.substr(0, 6) != "bytes=") return RangeResult::None;
+    header.remove_prefix(6);
+    bool any = false;
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        string_view spec = header.substr(0, comma);
+        header = comma == string_view::npos ? string_view() : header.substr(comma + 1);
+        while (!spec.empty() && spec.front() == ' ') spec.remove_prefix(1);
+        while (!spec.empty() && spec.back() == ' ') spec.remove_suffix(1);
+        size_t dash = spec.find('-');
+        if (dash == string_view::npos) return RangeResult::None;
+        string_view a = spec.substr(0, dash), b = spec.substr(dash + 1);
+        if (a.find_first_not_of("0123456789") != string_view::npos ||
+            b.find_first_not_of("0123456789") != string_view::npos || (a.empty() && b.empty()) ||
+            a.size() > 18 || b.size() > 18)
+            return RangeResult::None;
+        any = true;
+        long long first, last;
+        if (a.empty()) {                 // suffix: the last n bytes
+            long long n = atoll(string(b).c_str());
+            if (n == 0 || size == 0) continue;
+            first = max(0LL, size - n);
+            last = size - 1;
+        } else {
+            first = atoll(string(a).c_str());
+            last = b.empty() ? size - 1 : min(atoll(string(b).c_str()), size - 1);
+            if (!b.empty() && atoll(string(b).c_str()) < first) return RangeResult::None;
+            if (first >= size) continue;   // unsatisfiable on its own
+        }
+        ranges.emplace_back(first, last);
+        if (ranges.size() > MAX_RANGES) return RangeResult::None;
     }
+    if (!any) return RangeResult::None;
+    return ranges.empty() ? RangeResult::Unsatisfiable : RangeResult::Ok;
+}
+
+// If-Range carries either an ETag or a date; the range applies only if it
+// still names the current representation.
+bool ifRangeMatches(string_view ifRange, const string& etag, const string& lastModified) {
+    if (ifRange.empty()) return true;
+    if (ifRange.front() == '"') return ifRange == etag;
+    if (ifRange.substr(0, 2) == "W/") return false;   // weak validators never match for ranges
+    return ifRange == lastModified;
+}
+
+// Serves filename.br or filename.gz instead of filename when such a sibling
+// exists and the client accepts it. Sets encoding (null for identity) and
+// hasVariants, which decides whether the response must carry Vary.
+shared_ptr<OpenFile> openVariant(const string& filename, string_view acceptEncoding,
+                                 const char*& encoding, bool& hasVariants) {
+    static const pair<const char*, const char*> variants[] = {{"br", ".br"}, {"gzip", ".gz"}};
+    encoding = nullptr;
+    hasVariants = false;
+    shared_ptr<OpenFile> chosen;
+    for (const auto& variant : variants) {
+        shared_ptr<OpenFile> file = fileCache.get(filename + variant.second);
+        if (!file) continue;
+        hasVariants = true;
+        if (!chosen && acceptsEncoding(acceptEncoding, variant.first)) {
+            chosen = file;
+            encoding = variant.first;
+        }
+    }
+    return chosen;
+}
+
+// Reactor syscalls per response compare the epoll and io_uring modes under
+// the same load; the blocking modes make none of them.
+Response statusPage(bool keepAlive) {
+    MetricsSnapshot snap = MetricsRegistry::instance().snapshot();
+    uint64_t responses = 0;
+    for (int c = 1; c <= 5; ++c) responses += snap.responses[c];
     ostringstream body;
-    body << file.rdbuf();
-    string header = "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n";
-    string resp = header + body.str();
-    send(client, resp.c_str(), resp.size(), 0);
+    body << "reactor_syscalls " << snap.reactorSyscalls << "\n"
+         << "reactor_syscalls_per_response " << (responses ? (double)snap.reactorSyscalls / responses : 0) << "\n"
+         << "response_cache_hits " << responseCache->hits() << "\n"
+         << "response_cache_misses " << responseCache->misses() << "\n"
+         << "response_cache_evictions " << responseCache->evictions() << "\n"
+         << "response_cache_entries " << responseCache->entries() << "\n"
+         << "response_cache_bytes " << responseCache->bytesUsed() << "\n"
+         << "response_cache_capacity_bytes " << responseCache->capacity() << "\n";
+    Response resp;
+    resp.keepAlive = keepAlive;
+    resp.head = statusHead(200, "text/plain", body.str().size(), keepAlive) + body.str();
+    return resp;
+}
+
+// Prometheus text format: merged per-thread latency histograms plus counters.
+Response metricsPage(bool keepAlive) {
+    MetricsSnapshot snap = MetricsRegistry::instance().snapshot();
+    string body;
+    writePrometheusHistogram(body, "http_accept_to_first_byte_seconds",
+                             "Time from accepting a connection to writing its first response byte.",
+                             snap.histograms[AcceptToFirstByte]);
+    writePrometheusHistogram(body, "http_request_parse_seconds",
+                             "Time spent in the request parser for a complete request.",
+                             snap.histograms[ParseTime]);
+    writePrometheusHistogram(body, "http_response_build_seconds",
+                             "Time to build a response, including cache lookups and file reads.",
+                             snap.histograms[BuildTime]);
+    writePrometheusHistogram(body, "http_response_send_seconds",
+                             "Time from the first to the last byte of a response being written.",
+                             snap.histograms[SendTime]);
+    ostringstream counters;
+    counters << "# HELP http_response_bytes_total Bytes written in responses.\n"
+             << "# TYPE http_response_bytes_total counter\n"
+             << "http_response_bytes_total " << snap.bytesSent << "\n"
+             << "# HELP http_responses_total Responses sent, by status class.\n"
+             << "# TYPE http_responses_total counter\n";
+    for (int c = 1; c <= 5; ++c)
+        counters << "http_responses_total{code=\"" << c << "xx\"} " << snap.responses[c] << "\n";
+    counters << "# HELP http_connections_rejected_total Connections refused with a 503 by admission control.\n"
+             << "# TYPE http_connections_rejected_total counter\n"
+             << "http_connections_rejected_total " << snap.rejected << "\n"
+             << "# HELP http_reactor_syscalls_total System calls made by the epoll or io_uring reactor threads.\n"
+             << "# TYPE http_reactor_syscalls_total counter\n"
+             << "http_reactor_syscalls_total " << snap.reactorSyscalls << "\n";
+    counters << "# TYPE http_response_cache_hits_total counter\n"
+             << "http_response_cache_hits_total " << responseCache->hits() << "\n"
+             << "# TYPE http_response_cache_misses_total counter\n"
+             << "http_response_cache_misses_total " << responseCache->misses() << "\n"
+             << "# TYPE http_response_cache_evictions_total counter\n"
+             << "http_response_cache_evictions_total " << responseCache->evictions() << "\n"
+             << "# TYPE http_response_cache_bytes gauge\n"
+             << "http_response_cache_bytes " << responseCache->bytesUsed() << "\n";
+    body += counters.str();
+    Response resp;
+    resp.keepAlive = keepAlive;
+    resp.head = statusHead(200, "text/plain; version=0.0.4", body.size(), keepAlive) + body;
+    return resp;
+}
+
+// Reads a whole file for the response cache; null if the read comes up short.
+shared_ptr<const string> readWholeFile(const OpenFile& file) {
+    auto data = make_shared<string>(file.size, '\0');
+    long long done = 0;
+    while (done < file.size) {
+        long long n = readAt(file.fd, &(*data)[done], (size_t)(file.size - done), done);
+        if (n <= 0) return nullptr;
+        done += n;
+    }
+    return data;
+}
+
+// Build the response for a parsed request. Shared by every I/O mode.
+Response buildResponse(const HttpRequest& req) {
+    if (req.errorStatus) return errorResponse(req.errorStatus, false);
+    if (req.method != "GET") return errorResponse(501, req.keepAlive);
+    if (req.target == "/server-status") return statusPage(req.keepAlive);
+    if (req.target == "/metrics") return metricsPage(req.keepAlive);
+    // Remove leading slash
+    string_view path = req.target;
+    string filename = path == "/" ? "index.html" : string(path.substr(1));
+    shared_ptr<OpenFile> plain = fileCache.get(filename);
+    if (!plain) return errorResponse(404, req.keepAlive);
+
+    const char* encoding;
+    bool hasVariants;
+    shared_ptr<OpenFile> file = openVariant(filename, req.header("Accept-Encoding"), encoding, hasVariants);
+    if (!file) file = plain;
+    string etag = makeETag(*file, encoding);
+    string lastModified = httpDate(file->mtime);
+
+    Response resp;
+    resp.keepAlive = req.keepAlive;
+    string_view ifNoneMatch = req.header("If-None-Match");
+    bool notModified = !ifNoneMatch.empty() ? etagMatches(ifNoneMatch, etag)
+                                            : req.header("If-Modified-Since") == lastModified;
+    // Everything but the status line, Content-Length and Connection
+    string headers = "Content-Type: " + plain->contentType + "\r\nETag: " + etag +
+                     "\r\nLast-Modified: " + lastModified + "\r\n";
+    if (encoding) headers += string("Content-Encoding: ") + encoding + "\r\n";
+    if (hasVariants) headers += "Vary: Accept-Encoding\r\n";
+    if (notModified) {
+        resp.status = 304;
+        resp.head = "HTTP/1.1 304 Not Modified\r\n" + headers + connectionHeader(resp.keepAlive);
+        return resp;
+    }
+
+    string key = encoding ? filename + "\n" + encoding : filename;
+    shared_ptr<const CachedResponse> cached;
+    if (responseCache->fits(file->size)) {
+        cached = responseCache->get(key, file->mtime, file->size);
+        if (!cached) {
+            auto entry = make_shared<CachedResponse>();
+            entry->body = readWholeFile(*file);
+            if (entry->body) {
+                entry->head = "HTTP/1.1 200 OK\r\n" + headers + "Accept-Ranges: bytes\r\nContent-Length: " +
+                              to_string(file->size) + "\r\n";
+                entry->mtime = file->mtime;
+                entry->size = file->size;
+                responseCache->put(key, entry);
+                cached = entry;
+            }
+        }
+    }
+    // Body bytes come from the cached copy when there is one, else straight from the file
+    auto bodyRange = [&](long long offset, long long length) {
+        BodySegment seg;
+        if (cached) seg.data = cached->body;
+        else seg.file = file;
+        seg.offset = offset;
+        seg.length = length;
+        return seg;
+    };
+
+    vector<pair<long long, long long>> ranges;
+    RangeResult ranged = RangeResult::None;
+    string_view rangeHeader = req.header("Range");
+    if (!rangeHeader.empty() && ifRangeMatches(req.header("If-Range"), etag, lastModified))
+        ranged = parseRanges(rangeHeader, file->size, ranges);
+    if (ranged == RangeResult::Unsatisfiable) {
+        resp.status = 416;
+        resp.head = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" + to_string(file->size) +
+                    "\r\nContent-Length: 0\r\n" + connectionHeader(resp.keepAlive);
+        return resp;
+    }
+    if (ranged == RangeResult::Ok && ranges.size() == 1) {
+        long long first = ranges[0].first, last = ranges[0].second;
+        resp.status = 206;
+        resp.head = "HTTP/1.1 206 Partial Content\r\n" + headers + "Content-Range: bytes " + to_string(first) +
+                    "-" + to_string(last) + "/" + to_string(file->size) + "\r\nContent-Length: " +
+                    to_string(last - first + 1) + "\r\n" + connectionHeader(resp.keepAlive);
+        resp.body.push_back(bodyRange(first, last - first + 1));
+        return resp;
+    }
+    if (ranged == RangeResult::Ok) {
+        // multipart/byteranges: small shared boundary buffers interleaved with file ranges
+        static atomic<unsigned long long> boundaryCounter{0};
+        string boundary = "SimpleHttpRange" + to_string(boundaryCounter.fetch_add(1, memory_order_relaxed));
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            long long first = ranges[i].first, last = ranges[i].second;
+            auto part = make_shared<const string>(
+                string(i == 0 ? "" : "\r\n") + "--" + boundary + "\r\nContent-Type: " + plain->contentType +
+                "\r\nContent-Range: bytes " + to_string(first) + "-" + to_string(last) + "/" +
+                to_string(file->size) + "\r\n\r\n");
+            resp.body.push_back({part, nullptr, 0, (long long)part->size()});
+            resp.body.push_back(bodyRange(first, last - first + 1));
+        }
+        auto trailer = make_shared<const string>("\r\n--" + boundary + "--\r\n");
+        resp.body.push_back({trailer, nullptr, 0, (long long)trailer->size()});
+        resp.status = 206;
+        // Content-Type/Encoding of the parts replace the whole-file headers
+        string partHeaders = "ETag: " + etag + "\r\nLast-Modified: " + lastModified + "\r\n";
+        if (encoding) partHeaders += string("Content-Encoding: ") + encoding + "\r\n";
+        if (hasVariants) partHeaders += "Vary: Accept-Encoding\r\n";
+        resp.head = "HTTP/1.1 206 Partial Content\r\nContent-Type: multipart/byteranges; boundary=" + boundary +
+                    "\r\n" + partHeaders + "Content-Length: " + to_string(resp.bodyLength()) + "\r\n" +
+                    connectionHeader(resp.keepAlive);
+        return resp;
+    }
+
+    if (cached) resp.head = cached->head + connectionHeader(resp.keepAlive);
+    else
+        resp.head = "HTTP/1.1 200 OK\r\n" + headers + "Accept-Ranges: bytes\r\nContent-Length: " +
+                    to_string(file->size) + "\r\n" + connectionHeader(resp.keepAlive);
+    if (file->size > 0) resp.body.push_back(bodyRange(0, file->size));
+    return resp;
+}
+
+// Parses the next request in buf and builds its response, recording how long
+// each step took. Leaves resp untouched while the request is incomplete.
+ParseStatus nextResponse(HttpParser& parser, string_view buf, HttpRequest& req, Response& resp) {
+    ThreadMetrics& metrics = MetricsRegistry::local();
+    auto start = chrono::steady_clock::now();
+    ParseStatus status = parser.parse(buf, req);
+    if (status == ParseStatus::Incomplete) return status;
+    auto parsed = chrono::steady_clock::now();
+    metrics.histograms[ParseTime].record(elapsedNanos(start));
+    resp = buildResponse(req);
+    metrics.histograms[BuildTime].record(elapsedNanos(parsed));
+    return status;
+}
+
+// Records a fully written response.
+void recordSent(const Response& resp, size_t bytes) {
+    ThreadMetrics& metrics = MetricsRegistry::local();
+    metrics.histograms[SendTime].record(elapsedNanos(resp.sendStart));
+    metrics.add(metrics.bytesSent, bytes);
+    int statusClass = resp.status / 100;
+    if (statusClass >= 1 && statusClass <= 5) metrics.add(metrics.responses[statusClass], 1);
+}
+
+// Blocking send of a file range. Uses sendfile(2) where available, otherwise
+// streams through a fixed-size buffer so large files never sit in memory.
+bool sendFileRange(SOCKET s, const OpenFile& file, long long offset, long long len) {
+#ifdef __linux__
+    while (len > 0) {
+        off_t off = offset;
+        ssize_t n = sendfile(s, file.fd, &off, (size_t)min<long long>(len, 1 << 30));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        offset += n;
+        len -= n;
+    }
+    return true;
+#else
+    char buf[64 * 1024];
+    while (len > 0) {
+        long long n = readAt(file.fd, buf, (size_t)min<long long>(len, sizeof(buf)), offset);
+        if (n <= 0 || !sendAll(s, buf, (size_t)n)) return false;
+        offset += n;
+        len -= n;
+    }
+    return true;
+#endif
+}
+
+void setSocketTimeout(SOCKET s, int option, int ms) {
 #ifdef _WIN32
-    closesocket(client);
+    DWORD timeout = ms;
+    setsockopt(s, SOL_SOCKET, option, (const char*)&timeout, sizeof(timeout));
 #else
-    close(client);
+    timeval tv = {};
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(s, SOL_SOCKET, option, &tv, sizeof(tv));
 #endif
 }
 
-int main() {
+// Fixed set of worker threads fed through a bounded queue. Used by the
+// SO_REUSEPORT mode so a burst of connections queues (or is refused) instead
+// of spawning unbounded threads.
+class WorkerPool {
+public:
+    using Handler = function<void(SOCKET, chrono::steady_clock::time_point)>;
+
+    WorkerPool(size_t workers, size_t queueCapacity, Handler handler)
+        : capacity(queueCapacity), handler(move(handler)) {
+        for (size_t i = 0; i < workers; ++i) threads.emplace_back([this]() { workerLoop(); });
+    }
+
+    // Returns false if the queue is full; the caller still owns the socket.
+    bool trySubmit(SOCKET s, chrono::steady_clock::time_point acceptedAt) {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (queue.size() >= capacity) return false;
+            queue.emplace_back(s, acceptedAt);
+            waiting.store(queue.size(), memory_order_relaxed);
+        }
+        cv.notify_one();
+        return true;
+    }
+
+    // Connections accepted but not yet picked up by a worker.
+    bool hasWaiting() const { return waiting.load(memory_order_relaxed) > 0; }
+
+private:
+    void workerLoop() {
+        while (true) {
+            pair<SOCKET, chrono::steady_clock::time_point> job;
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [this]() { return !queue.empty(); });
+                job = queue.front();
+                queue.pop_front();
+                waiting.store(queue.size(), memory_order_relaxed);
+            }
+            handler(job.first, job.second);
+        }
+    }
+
+    size_t capacity;
+    Handler handler;
+    mutex mtx;
+    condition_variable cv;
+    deque<pair<SOCKET, chrono::steady_clock::time_point>> queue;
+    atomic<size_t> waiting{0};
+    vector<thread> threads;
+};
+
+// Switches a keep-alive response to Connection: close before it is sent.
+void announceClose(Response& resp) {
+    const char* keepAlive = connectionHeader(true);
+    size_t at = resp.head.find(keepAlive);
+    if (at == string::npos) return;
+    resp.head.replace(at, strlen(keepAlive), connectionHeader(false));
+    resp.keepAlive = false;
+}
+
+// Blocking handler for the thread and worker-pool modes: serves keep-alive and
+// pipelined requests until the client closes, asks to close, stays idle too
+// long, or takes longer than readTimeoutSeconds to send one request. When pool
+// has connections waiting for a worker, the response to the last buffered
+// request says Connection: close and the worker moves on once it is sent. The
+// client learns of the close from the response, so it reconnects instead of
+// having its next request reset, and a new connection is always read first.
+void handle_client(SOCKET client, chrono::steady_clock::time_point acceptedAt, const WorkerPool* pool) {
+    int recvTimeoutMs = idleTimeoutSeconds * 1000;
+    setSocketTimeout(client, SO_RCVTIMEO, recvTimeoutMs);
+    setSocketTimeout(client, SO_SNDTIMEO, writeTimeoutSeconds * 1000);
+    // Head and body go out in separate sends; don't let Nagle hold the body back
+    int one = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    string in;
+    HttpParser parser;
+    HttpRequest req;
+    Response resp;
+    char buffer[4096];
+    bool open = true;
+    bool firstResponse = true;
+    chrono::steady_clock::time_point requestStart;   // first byte of a still incomplete request
+    while (open) {
+        size_t consumed = 0;
+        ParseStatus status;
+        while (open &&
+               (status = nextResponse(parser, string_view(in).substr(consumed), req, resp)) != ParseStatus::Incomplete) {
+            if (pool && resp.keepAlive && consumed + req.length == in.size() && pool->hasWaiting())
+                announceClose(resp);
+            open = resp.keepAlive && status == ParseStatus::Complete;
+            consumed += req.length;
+            parser.reset();
+            resp.sendStart = chrono::steady_clock::now();
+            if (!sendAll(client, resp.head.data(), resp.head.size(), resp.body.empty() ? 0 : MSG_MORE)) break;
+            if (firstResponse) {
+                MetricsRegistry::local().histograms[AcceptToFirstByte].record(elapsedNanos(acceptedAt));
+                firstResponse = false;
+            }
+            bool sent = true;
+            for (size_t i = 0; sent && i < resp.body.size(); ++i) {
+                const BodySegment& seg = resp.body[i];
+                int flags = i + 1 < resp.body.size() ? MSG_MORE : 0;
+                sent = seg.file ? sendFileRange(client, *seg.file, seg.offset, seg.length)
+                                : sendAll(client, seg.data->data() + seg.offset, (size_t)seg.length, flags);
+            }
+            if (!sent) break;
+            recordSent(resp, resp.head.size() + resp.bodyLength());
+        }
+        if (!open) break;
+        in.erase(0, consumed);
+
+        // Between requests wait up to the idle timeout; inside a request the
+        // remainder of the read timeout, so trickling bytes cannot pin us.
+        int wantTimeoutMs = idleTimeoutSeconds * 1000;
+        if (!in.empty()) {
+            auto now = chrono::steady_clock::now();
+            if (consumed > 0 || requestStart == chrono::steady_clock::time_point()) requestStart = now;
+            long long left = readTimeoutSeconds * 1000LL -
+                             chrono::duration_cast<chrono::milliseconds>(now - requestStart).count();
+            if (left <= 0) {
+                Response timeout = errorResponse(408, false);
+                sendAll(client, timeout.head.data(), timeout.head.size());
+                break;
+            }
+            wantTimeoutMs = (int)min<long long>(left, wantTimeoutMs);
+        }
+        if (wantTimeoutMs != recvTimeoutMs) {
+            recvTimeoutMs = wantTimeoutMs;
+            setSocketTimeout(client, SO_RCVTIMEO, recvTimeoutMs);
+        }
+        int recvlen = recv(client, buffer, sizeof(buffer), 0);
+        if (recvlen <= 0) break;   // closed, error or timeout
+        if (in.empty()) requestStart = chrono::steady_clock::now();
+        in.append(buffer, recvlen);
+    }
+    closeSocket(client);
+}
+
+#ifdef __linux__
+// --- epoll reactor mode ---
+// Every reactor thread owns an epoll instance and the connections it accepted.
+// The listening socket is registered in all of them with EPOLLEXCLUSIVE so a
+// new connection wakes a single reactor. Sockets are edge-triggered, so each
+// readiness event is drained until EAGAIN.
+
+// Responses queued per connection before we stop reading further pipelined
+// requests; keeps a client that never reads from growing our memory.
+const size_t MAX_PIPELINE = 32;
+
+struct Connection {
+    int fd;
+    string in;                     // received bytes not yet consumed by the parser
+    HttpParser parser;
+    deque<Response> out;           // pipelined responses, in request order
+    size_t headSent = 0;           // progress through out.front(): head bytes,
+    size_t segment = 0;            // then the current body segment
+    long long segmentSent = 0;     // and the bytes of it already written
+    bool closing = false;          // a queued response ends the connection
+    bool peerClosed = false;       // client shut down its sending side
+    bool readBlocked = false;      // stopped reading because out is full
+    bool firstByteSent = false;
+    size_t responseBytes = 0;      // bytes of out.front() written so far
+    chrono::steady_clock::time_point acceptedAt;
+    chrono::steady_clock::time_point lastActive;
+    chrono::steady_clock::time_point requestStart;   // first byte of the request still in `in`
+    chrono::steady_clock::time_point lastWrite;      // out.front() last made progress
+};
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+class Reactor {
+public:
+    explicit Reactor(int listenFd) : listenFd(listenFd) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        watchListener();
+    }
+
+    ~Reactor() { close(epfd); }
+
+    void run() {
+        epoll_event events[256];
+        ThreadMetrics& metrics = MetricsRegistry::local();
+        auto lastSweep = chrono::steady_clock::now();
+        while (true) {
+            metrics.add(metrics.reactorSyscalls, syscalls);   // those of the previous pass
+            syscalls = 1;                                     // this epoll_wait
+            int n = epoll_wait(epfd, events, 256, 1000);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (!events[i].data.ptr) {
+                    acceptAll();
+                    continue;
+                }
+                Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+                if (events[i].events & EPOLLERR) {
+                    closeConnection(conn);
+                    continue;
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !onReadable(conn)) continue;
+                onWritable(conn);
+            }
+            auto now = chrono::steady_clock::now();
+            if (now - lastSweep >= chrono::seconds(1)) {
+                closeExpired(now);
+                if (acceptPaused) resumeAccept();
+                lastSweep = now;
+            }
+        }
+    }
+
+private:
+    void watchListener() {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = nullptr;   // nullptr marks the listening socket
+        epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+    }
+
+    // The listener is level-triggered, so while a pending connection cannot
+    // be accepted for lack of descriptors epoll_wait would return at once,
+    // forever. It is unwatched until a connection closes or the next sweep.
+    void pauseAccept() {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, listenFd, nullptr);
+        syscalls++;
+        acceptPaused = true;
+    }
+
+    void resumeAccept() {
+        watchListener();
+        syscalls++;
+        acceptPaused = false;
+    }
+
+    void acceptAll() {
+        while (true) {
+            syscalls++;
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EMFILE || errno == ENFILE) pauseAccept();
+                return;   // EAGAIN: backlog drained
+            }
+            auto conn = make_unique<Connection>();
+            conn->fd = fd;
+            conn->acceptedAt = conn->lastActive = chrono::steady_clock::now();
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = conn.get();
+            syscalls++;
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                close(fd);
+                continue;
+            }
+            conns[fd] = move(conn);
+        }
+    }
+
+    // Drains the socket and queues responses for every complete request.
+    // Returns false if the connection was closed.
+    bool onReadable(Connection* conn) {
+        char buf[16 * 1024];
+        while (!conn->closing && !conn->peerClosed) {
+            if (conn->out.size() >= MAX_PIPELINE) {
+                conn->readBlocked = true;   // resumed by onWritable once the queue drains
+                break;
+            }
+            syscalls++;
+            ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                conn->lastActive = chrono::steady_clock::now();
+                if (conn->in.empty()) conn->requestStart = conn->lastActive;
+                conn->in.append(buf, n);
+                parseRequests(conn);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0) {
+                closeConnection(conn);
+                return false;
+            }
+            conn->peerClosed = true;   // EOF: answer what was already requested, then close
+        }
+        if (conn->peerClosed && conn->out.empty()) {
+            closeConnection(conn);
+            return false;
+        }
+        return true;
+    }
+
+    void parseRequests(Connection* conn) {
+        size_t consumed = 0;
+        HttpRequest req;
+        Response resp;
+        while (!conn->closing && conn->out.size() < MAX_PIPELINE) {
+            ParseStatus status = nextResponse(conn->parser, string_view(conn->in).substr(consumed), req, resp);
+            if (status == ParseStatus::Incomplete) break;
+            if (conn->out.empty()) conn->lastWrite = chrono::steady_clock::now();
+            conn->out.push_back(move(resp));
+            if (!conn->out.back().keepAlive) conn->closing = true;
+            if (status == ParseStatus::Error) break;
+            consumed += req.length;
+            conn->parser.reset();
+        }
+        conn->in.erase(0, consumed);
+    }
+
+    void onWritable(Connection* conn) {
+        while (flush(conn)) {
+            if (conn->peerClosed) {
+                closeConnection(conn);
+                return;
+            }
+            if (!conn->readBlocked) return;
+            conn->readBlocked = false;
+            parseRequests(conn);   // requests already buffered while we were blocked
+            if (!onReadable(conn)) return;
+        }
+    }
+
+    // Writes queued responses. Returns true once the queue is empty, false if
+    // the socket would block or the connection was closed.
+    bool flush(Connection* conn) {
+        while (!conn->out.empty()) {
+            Response& out = conn->out.front();
+            ssize_t n;
+            bool fileNext = conn->segment < out.body.size() && out.body[conn->segment].file;
+            if (conn->headSent < out.head.size() || (conn->segment < out.body.size() && !fileNext)) {
+                // Gather the rest of the head and the following in-memory segments into one
+                // sendmsg. MSG_MORE lets the kernel pack them with a file range or the next
+                // pipelined response.
+                iovec iov[16];
+                int iovcnt = 0;
+                if (conn->headSent < out.head.size()) {
+                    iov[iovcnt].iov_base = (void*)(out.head.data() + conn->headSent);
+                    iov[iovcnt++].iov_len = out.head.size() - conn->headSent;
+                }
+                size_t i = conn->segment;
+                for (; i < out.body.size() && iovcnt < 16 && !out.body[i].file; ++i) {
+                    const BodySegment& seg = out.body[i];
+                    long long done = i == conn->segment ? conn->segmentSent : 0;
+                    iov[iovcnt].iov_base = (void*)(seg.data->data() + seg.offset + done);
+                    iov[iovcnt++].iov_len = (size_t)(seg.length - done);
+                }
+                msghdr msg = {};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = iovcnt;
+                bool more = i < out.body.size() || conn->out.size() > 1;
+                syscalls++;
+                n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+                if (n > 0) advance(conn, out, n);
+            } else if (fileNext) {
+                const BodySegment& seg = out.body[conn->segment];
+                off_t off = seg.offset + conn->segmentSent;
+                syscalls++;
+                n = sendfile(conn->fd, seg.file->fd, &off,
+                             (size_t)min<long long>(seg.length - conn->segmentSent, 1 << 30));
+                if (n > 0) advance(conn, out, n);
+            } else {
+                // Response complete
+                recordSent(out, conn->responseBytes);
+                conn->responseBytes = 0;
+                bool keepAlive = out.keepAlive;
+                conn->out.pop_front();
+                conn->headSent = 0;
+                conn->segment = 0;
+                conn->segmentSent = 0;
+                if (!keepAlive) {
+                    closeConnection(conn);
+                    return false;
+                }
+                // A request that waited behind this one gets its full read timeout
+                conn->requestStart = conn->lastWrite = chrono::steady_clock::now();
+                continue;
+            }
+            if (n > 0) {
+                auto now = chrono::steady_clock::now();
+                conn->lastActive = conn->lastWrite = now;
+                if (conn->responseBytes == 0) {
+                    out.sendStart = now;
+                    if (!conn->firstByteSent) {
+                        MetricsRegistry::local().histograms[AcceptToFirstByte].record(elapsedNanos(conn->acceptedAt));
+                        conn->firstByteSent = true;
+                    }
+                }
+                conn->responseBytes += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;   // wait for EPOLLOUT
+            closeConnection(conn);
+            return false;
+        }
+        return true;
+    }
+
+    // Moves the write position of the front response forward by n bytes.
+    static void advance(Connection* conn, const Response& out, size_t n) {
+        size_t fromHead = min(n, out.head.size() - conn->headSent);
+        conn->headSent += fromHead;
+        n -= fromHead;
+        while (n > 0 && conn->segment < out.body.size()) {
+            long long take = min<long long>((long long)n, out.body[conn->segment].length - conn->segmentSent);
+            conn->segmentSent += take;
+            n -= take;
+            if (conn->segmentSent == out.body[conn->segment].length) {
+                conn->segment++;
+                conn->segmentSent = 0;
+            }
+        }
+    }
+
+    // Closes connections whose client stopped reading a response for
+    // writeTimeoutSeconds, has been sending one request for readTimeoutSeconds
+    // (answered with a 408, so trickling bytes cannot hold the connection), or
+    // sat idle between requests for idleTimeoutSeconds.
+    void closeExpired(chrono::steady_clock::time_point now) {
+        vector<Connection*> expired;
+        for (auto& entry : conns) {
+            Connection* conn = entry.second.get();
+            bool late;
+            if (!conn->out.empty()) late = now - conn->lastWrite > chrono::seconds(writeTimeoutSeconds);
+            else if (!conn->in.empty()) {
+                late = now - conn->requestStart > chrono::seconds(readTimeoutSeconds);
+                if (late) {
+                    static const Response timeout = errorResponse(408, false);
+                    syscalls++;
+                    send(conn->fd, timeout.head.data(), timeout.head.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                }
+            } else late = now - conn->lastActive > chrono::seconds(idleTimeoutSeconds);
+            if (late) expired.push_back(conn);
+        }
+        for (Connection* conn : expired) closeConnection(conn);
+    }
+
+    void closeConnection(Connection* conn) {
+        int fd = conn->fd;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        syscalls += 2;
+        conns.erase(fd);   // destroys conn
+        if (acceptPaused) resumeAccept();   // a descriptor is free again
+    }
+
+    int epfd;
+    int listenFd;
+    unordered_map<int, unique_ptr<Connection>> conns;
+    uint64_t syscalls = 0;   // made since the last epoll_wait, published to metrics before the next
+    bool acceptPaused = false;
+};
+
+void runReactors(int server, int reactorCount) {
+    setNonBlocking(server);
+    vector<thread> threads;
+    for (int i = 0; i < reactorCount; ++i) {
+        threads.emplace_back([server]() {
+            Reactor reactor(server);
+            reactor.run();
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+// --- SO_REUSEPORT mode ---
+// One listening socket per acceptor thread, all bound to the same port with
+// SO_REUSEPORT so the kernel spreads incoming connections across them. Each
+// acceptor feeds its own fixed-size worker pool. Admission control caps the
+// connections queued or in service across all acceptors; beyond the cap new
+// connections get an immediate 503 instead of waiting in a backlog.
+
+atomic<int> admittedConnections{0};
+
+int openReusePortListener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void rejectConnection(int fd) {
+    static const Response busy = errorResponse(503, false);
+    ssize_t n = send(fd, busy.head.data(), busy.head.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(fd);
+    ThreadMetrics& metrics = MetricsRegistry::local();
+    metrics.add(metrics.rejected, 1);
+    metrics.add(metrics.responses[5], 1);
+    if (n > 0) metrics.add(metrics.bytesSent, n);
+}
+
+void acceptLoop(int listenFd, size_t workers, size_t queueCapacity, int maxConnections) {
+    WorkerPool* pool = nullptr;
+    WorkerPool workerPool(workers, queueCapacity, [&pool](SOCKET client, chrono::steady_clock::time_point at) {
+        handle_client(client, at, pool);
+        admittedConnections.fetch_sub(1, memory_order_relaxed);
+    });
+    pool = &workerPool;
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) this_thread::sleep_for(chrono::milliseconds(10));
+            continue;
+        }
+        auto acceptedAt = chrono::steady_clock::now();
+        if (admittedConnections.fetch_add(1, memory_order_relaxed) >= maxConnections) {
+            admittedConnections.fetch_sub(1, memory_order_relaxed);
+            rejectConnection(fd);
+            continue;
+        }
+        if (!workerPool.trySubmit(fd, acceptedAt)) {
+            admittedConnections.fetch_sub(1, memory_order_relaxed);
+            rejectConnection(fd);
+        }
+    }
+}
+
+bool runReusePort(int port, int acceptors, size_t workers, size_t queueCapacity, int maxConnections) {
+    vector<int> listeners;
+    for (int i = 0; i < acceptors; ++i) {
+        int fd = openReusePortListener(port);
+        if (fd < 0) {
+            cerr << "Could not bind SO_REUSEPORT listener: " << strerror(errno) << "\n";
+            for (int l : listeners) close(l);
+            return false;
+        }
+        listeners.push_back(fd);
+    }
+    vector<thread> threads;
+    for (int fd : listeners)
+        threads.emplace_back(acceptLoop, fd, workers, queueCapacity, maxConnections);
+    for (auto& t : threads) t.join();
+    return true;
+}
+
+// --- io_uring mode ---
+// Same HTTP handling as the epoll reactor, but every accept, recv, send and
+// file read is a submission queue entry. All SQEs prepared while handling a
+// batch of completions go to the kernel in one io_uring_enter, which also
+// waits for the next batch, so a busy reactor makes one syscall per batch
+// instead of one per operation. File bodies are read into a per-connection
+// 64 KB buffer and sent from there (sendfile has no io_uring opcode).
+
+enum UringOp : uint64_t { OpAccept = 1, OpRecv = 2, OpSend = 3, OpRead = 4, OpTimer = 5 };
+const uint64_t OP_MASK = 7;   // connection pointers are 8-byte aligned
+const size_t URING_RECV_BUFFER = 16 * 1024;
+const size_t URING_FILE_BUFFER = 64 * 1024;
+
+struct UringConnection {
+    int fd;
+    string in;
+    HttpParser parser;
+    deque<Response> out;
+    size_t headSent = 0;
+    size_t segment = 0;
+    long long segmentSent = 0;
+    unique_ptr<char[]> fileBuf;    // allocated while a file segment is being sent
+    size_t fileBufLen = 0;         // bytes read into fileBuf
+    size_t fileBufSent = 0;        // bytes of fileBuf already sent
+    bool sendingFile = false;      // the in-flight send comes from fileBuf
+    int inFlight = 0;              // submitted operations not yet completed
+    bool recvPending = false;
+    bool writePending = false;     // a send or file read is in flight
+    bool closing = false;
+    bool peerClosed = false;
+    bool shuttingDown = false;
+    bool firstByteSent = false;
+    size_t responseBytes = 0;
+    chrono::steady_clock::time_point acceptedAt, lastActive;
+    chrono::steady_clock::time_point requestStart, lastWrite;   // as in Connection
+    iovec iov[16];
+    msghdr msg = {};
+    char recvBuf[URING_RECV_BUFFER];
+};
+
+class UringReactor {
+public:
+    UringReactor(int listenFd) : listenFd(listenFd) {}
+
+    ~UringReactor() {
+        for (auto* conn : conns) {
+            close(conn->fd);
+            delete conn;
+        }
+    }
+
+    bool init() { return ring.init(4096); }
+
+    void run() {
+        ThreadMetrics& metrics = MetricsRegistry::local();
+        armAccept();
+        armTimer();
+        while (true) {
+            int ret = ring.submitAndWait(1);
+            if (ret < 0 && errno != EINTR && errno != EBUSY) {
+                cerr << "io_uring_enter failed: " << strerror(errno) << "\n";
+                return;
+            }
+            ring.forEachCompletion([this](const io_uring_cqe& cqe) { onCompletion(cqe); });
+            // Every io_uring_enter (including flushes of a full queue) plus the
+            // few calls made outside the ring
+            metrics.add(metrics.reactorSyscalls, ring.enters() - entersReported + syscalls);
+            entersReported = ring.enters();
+            syscalls = 0;
+        }
+    }
+
+private:
+    io_uring_sqe* sqe() {
+        io_uring_sqe* e;
+        while (!(e = ring.getSqe())) ring.submitAndWait(0);   // queue full: flush and retry
+        return e;
+    }
+
+    io_uring_sqe* connSqe(UringConnection* conn, UringOp op) {
+        io_uring_sqe* e = sqe();
+        e->user_data = (uint64_t)conn | op;
+        conn->inFlight++;
+        return e;
+    }
+
+    void armAccept() {
+        io_uring_sqe* e = sqe();
+        e->opcode = IORING_OP_ACCEPT;
+        e->fd = listenFd;
+        e->accept_flags = SOCK_CLOEXEC;
+        e->user_data = OpAccept;
+    }
+
+    // Fires once a second to expire connections and retry a paused accept.
+    void armTimer() {
+        timerSpec.tv_sec = 1;
+        timerSpec.tv_nsec = 0;
+        io_uring_sqe* e = sqe();
+        e->opcode = IORING_OP_TIMEOUT;
+        e->addr = (uint64_t)&timerSpec;
+        e->len = 1;
+        e->user_data = OpTimer;
+    }
+
+    void armRecv(UringConnection* conn) {
+        if (conn->recvPending || conn->closing || conn->peerClosed || conn->shuttingDown ||
+            conn->out.size() >= MAX_PIPELINE)
+            return;
+        io_uring_sqe* e = connSqe(conn, OpRecv);
+        e->opcode = IORING_OP_RECV;
+        e->fd = conn->fd;
+        e->addr = (uint64_t)conn->recvBuf;
+        e->len = URING_RECV_BUFFER;
+        conn->recvPending = true;
+    }
+
+    // Queues the next write step for the front response, if none is in flight.
+    void pumpWrite(UringConnection* conn) {
+        while (!conn->writePending && !conn->shuttingDown && !conn->out.empty()) {
+            Response& out = conn->out.front();
+            if (conn->headSent == out.head.size() && conn->segment == out.body.size()) {
+                finishResponse(conn);
+                continue;
+            }
+            bool fileNext = conn->headSent == out.head.size() && out.body[conn->segment].file;
+            if (!fileNext) {
+                int iovcnt = 0;
+                if (conn->headSent < out.head.size()) {
+                    conn->iov[iovcnt].iov_base = (void*)(out.head.data() + conn->headSent);
+                    conn->iov[iovcnt++].iov_len = out.head.size() - conn->headSent;
+                }
+                for (size_t i = conn->segment; i < out.body.size() && iovcnt < 16 && !out.body[i].file; ++i) {
+                    const BodySegment& seg = out.body[i];
+                    long long done = i == conn->segment ? conn->segmentSent : 0;
+                    conn->iov[iovcnt].iov_base = (void*)(seg.data->data() + seg.offset + done);
+                    conn->iov[iovcnt++].iov_len = (size_t)(seg.length - done);
+                }
+                conn->msg = {};
+                conn->msg.msg_iov = conn->iov;
+                conn->msg.msg_iovlen = iovcnt;
+                io_uring_sqe* e = connSqe(conn, OpSend);
+                e->opcode = IORING_OP_SENDMSG;
+                e->fd = conn->fd;
+                e->addr = (uint64_t)&conn->msg;
+                e->msg_flags = MSG_NOSIGNAL;
+                conn->sendingFile = false;
+            } else if (conn->fileBufSent < conn->fileBufLen) {
+                io_uring_sqe* e = connSqe(conn, OpSend);
+                e->opcode = IORING_OP_SEND;
+                e->fd = conn->fd;
+                e->addr = (uint64_t)(conn->fileBuf.get() + conn->fileBufSent);
+                e->len = (unsigned)(conn->fileBufLen - conn->fileBufSent);
+                e->msg_flags = MSG_NOSIGNAL;
+                conn->sendingFile = true;
+            } else {
+                const BodySegment& seg = out.body[conn->segment];
+                if (!conn->fileBuf) conn->fileBuf.reset(new char[URING_FILE_BUFFER]);
+                io_uring_sqe* e = connSqe(conn, OpRead);
+                e->opcode = IORING_OP_READ;
+                e->fd = seg.file->fd;
+                e->addr = (uint64_t)conn->fileBuf.get();
+                e->len = (unsigned)min<long long>(seg.length - conn->segmentSent, URING_FILE_BUFFER);
+                e->off = seg.offset + conn->segmentSent;
+            }
+            conn->writePending = true;
+        }
+    }
+
+    void finishResponse(UringConnection* conn) {
+        Response& out = conn->out.front();
+        recordSent(out, conn->responseBytes);
+        bool keepAlive = out.keepAlive;
+        conn->out.pop_front();
+        conn->headSent = conn->segment = 0;
+        conn->segmentSent = 0;
+        conn->responseBytes = 0;
+        if (conn->out.empty()) conn->fileBuf.reset();   // idle connections keep no file buffer
+        if (!keepAlive) {
+            closeConnection(conn);
+            return;
+        }
+        if (conn->out.empty() && conn->peerClosed) {
+            closeConnection(conn);
+            return;
+        }
+        conn->requestStart = conn->lastWrite = chrono::steady_clock::now();
+        parseRequests(conn);   // requests held back while the pipeline was full
+        armRecv(conn);
+    }
+
+    void onCompletion(const io_uring_cqe& cqe) {
+        uint64_t op = cqe.user_data & OP_MASK;
+        if (op == OpAccept) {
+            onAccept(cqe.res);
+            return;
+        }
+        if (op == OpTimer) {
+            closeExpired(chrono::steady_clock::now());
+            if (acceptPaused) resumeAccept();
+            armTimer();
+            return;
+        }
+        UringConnection* conn = (UringConnection*)(cqe.user_data & ~OP_MASK);
+        conn->inFlight--;
+        if (op == OpRecv) conn->recvPending = false;
+        else conn->writePending = false;
+        if (!conn->shuttingDown) {
+            if (op == OpRecv) onRecv(conn, cqe.res);
+            else if (op == OpSend) onSend(conn, cqe.res);
+            else onRead(conn, cqe.res);
+        }
+        if (conn->shuttingDown && conn->inFlight == 0) destroy(conn);
+    }
+
+    void onAccept(int fd) {
+        if (fd < 0 && fd != -ECONNABORTED && fd != -EINTR) {
+            // Out of descriptors (EMFILE/ENFILE) or a failing listener: an accept
+            // armed now would fail straight away and spin the ring. Resume once a
+            // connection frees its descriptor, or on the next timer tick.
+            acceptPaused = true;
+            return;
+        }
+        armAccept();
+        if (fd < 0) return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(one));
+        syscalls++;
+        auto* conn = new UringConnection();
+        conn->fd = fd;
+        conn->acceptedAt = conn->lastActive = chrono::steady_clock::now();
+        conns.insert(conn);
+        armRecv(conn);
+    }
+
+    void resumeAccept() {
+        acceptPaused = false;
+        armAccept();
+    }
+
+    void onRecv(UringConnection* conn, int res) {
+        if (res < 0) {
+            closeConnection(conn);
+            return;
+        }
+        if (res == 0) {
+            conn->peerClosed = true;   // answer what was already requested, then close
+            if (conn->out.empty() && !conn->writePending) closeConnection(conn);
+            return;
+        }
+        conn->lastActive = chrono::steady_clock::now();
+        if (conn->in.empty()) conn->requestStart = conn->lastActive;
+        conn->in.append(conn->recvBuf, res);
+        parseRequests(conn);
+        pumpWrite(conn);
+        if (!conn->shuttingDown) armRecv(conn);
+    }
+
+    void onSend(UringConnection* conn, int res) {
+        if (res <= 0) {
+            closeConnection(conn);
+            return;
+        }
+        auto now = chrono::steady_clock::now();
+        conn->lastActive = conn->lastWrite = now;
+        Response& out = conn->out.front();
+        if (conn->responseBytes == 0) {
+            out.sendStart = now;
+            if (!conn->firstByteSent) {
+                MetricsRegistry::local().histograms[AcceptToFirstByte].record(elapsedNanos(conn->acceptedAt));
+                conn->firstByteSent = true;
+            }
+        }
+        conn->responseBytes += res;
+        if (conn->sendingFile) conn->fileBufSent += res;
+        size_t n = res;
+        size_t fromHead = min(n, out.head.size() - conn->headSent);
+        conn->headSent += fromHead;
+        n -= fromHead;
+        while (n > 0 && conn->segment < out.body.size()) {
+            long long take = min<long long>((long long)n, out.body[conn->segment].length - conn->segmentSent);
+            conn->segmentSent += take;
+            n -= take;
+            if (conn->segmentSent == out.body[conn->segment].length) {
+                conn->segment++;
+                conn->segmentSent = 0;
+            }
+        }
+        pumpWrite(conn);
+    }
+
+    void onRead(UringConnection* conn, int res) {
+        if (res <= 0) {   // file shrank or read error: the response cannot be completed
+            closeConnection(conn);
+            return;
+        }
+        conn->fileBufLen = res;
+        conn->fileBufSent = 0;
+        pumpWrite(conn);
+    }
+
+    void parseRequests(UringConnection* conn) {
+        size_t consumed = 0;
+        HttpRequest req;
+        Response resp;
+        while (!conn->closing && conn->out.size() < MAX_PIPELINE) {
+            ParseStatus status = nextResponse(conn->parser, string_view(conn->in).substr(consumed), req, resp);
+            if (status == ParseStatus::Incomplete) break;
+            if (conn->out.empty()) conn->lastWrite = chrono::steady_clock::now();
+            conn->out.push_back(move(resp));
+            if (!conn->out.back().keepAlive) conn->closing = true;
+            if (status == ParseStatus::Error) break;
+            consumed += req.length;
+            conn->parser.reset();
+        }
+        conn->in.erase(0, consumed);
+    }
+
+    // Same limits as the epoll reactor's closeExpired()
+    void closeExpired(chrono::steady_clock::time_point now) {
+        vector<UringConnection*> expired;
+        for (auto* conn : conns) {
+            if (conn->shuttingDown) continue;
+            bool late;
+            if (!conn->out.empty()) late = now - conn->lastWrite > chrono::seconds(writeTimeoutSeconds);
+            else if (!conn->in.empty()) {
+                late = now - conn->requestStart > chrono::seconds(readTimeoutSeconds);
+                if (late) {
+                    static const Response timeout = errorResponse(408, false);
+                    send(conn->fd, timeout.head.data(), timeout.head.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                    syscalls++;
+                }
+            } else late = now - conn->lastActive > chrono::seconds(idleTimeoutSeconds);
+            if (late) expired.push_back(conn);
+        }
+        for (auto* conn : expired) {
+            closeConnection(conn);
+            if (conn->inFlight == 0) destroy(conn);
+        }
+    }
+
+    // Shutting the socket down makes any in-flight recv/send complete; the
+    // connection is freed once the last of them has been reaped, never from
+    // inside a handler that may still touch it.
+    void closeConnection(UringConnection* conn) {
+        if (conn->shuttingDown) return;
+        conn->shuttingDown = true;
+        shutdown(conn->fd, SHUT_RDWR);
+        syscalls++;
+    }
+
+    void destroy(UringConnection* conn) {
+        close(conn->fd);
+        syscalls++;
+        conns.erase(conn);
+        delete conn;
+        if (acceptPaused) resumeAccept();   // a descriptor is free again
+    }
+
+    IoUring ring;
+    int listenFd;
+    __kernel_timespec timerSpec = {};
+    unordered_set<UringConnection*> conns;
+    bool acceptPaused = false;          // accept failed; re-armed by destroy() or the timer
+    uint64_t syscalls = 0;              // outside the ring, since the last publish
+    unsigned long long entersReported = 0;
+};
+
+// Returns false if io_uring is unavailable so the caller can fall back to epoll.
+bool runUringReactors(int server, int reactorCount) {
+    vector<unique_ptr<UringReactor>> reactors;
+    for (int i = 0; i < reactorCount; ++i) {
+        reactors.push_back(make_unique<UringReactor>(server));
+        if (!reactors.back()->init()) {
+            cerr << "io_uring unavailable: " << strerror(errno) << "\n";
+            return false;
+        }
+    }
+    vector<thread> threads;
+    for (auto& reactor : reactors) threads.emplace_back([&reactor]() { reactor->run(); });
+    for (auto& t : threads) t.join();
+    return true;
+}
+#endif
+
+int main(int argc, char* argv[]) {
     initSockets();
     int port = 8080;
+#ifdef __linux__
+    string mode = "epoll";
+#else
+    string mode = "threads";
+#endif
+    int reactors = (int)thread::hardware_concurrency();
+    if (reactors <= 0) reactors = 1;
+    int cacheMegabytes = 64;
+    int acceptors = reactors;
+    int workers = 16;            // per acceptor
+    int maxConnections = 4096;   // queued or in service, across all acceptors
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--mode=", 0) == 0) mode = arg.substr(7);
+        else if (arg.rfind("--reactors=", 0) == 0) reactors = max(1, atoi(arg.c_str() + 11));
+        else if (arg.rfind("--port=", 0) == 0) port = atoi(arg.c_str() + 7);
+        else if (arg.rfind("--idle-timeout=", 0) == 0) idleTimeoutSeconds = max(1, atoi(arg.c_str() + 15));
+        else if (arg.rfind("--cache-mb=", 0) == 0) cacheMegabytes = max(0, atoi(arg.c_str() + 11));
+        else if (arg.rfind("--acceptors=", 0) == 0) acceptors = max(1, atoi(arg.c_str() + 12));
+        else if (arg.rfind("--workers=", 0) == 0) workers = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--max-connections=", 0) == 0) maxConnections = max(1, atoi(arg.c_str() + 18));
+        else if (arg.rfind("--read-timeout=", 0) == 0) readTimeoutSeconds = max(1, atoi(arg.c_str() + 15));
+        else if (arg.rfind("--write-timeout=", 0) == 0) writeTimeoutSeconds = max(1, atoi(arg.c_str() + 16));
+        else {
+            cerr << "Usage: " << argv[0] << " [--mode=epoll|uring|threads|reuseport] [--reactors=N] [--port=N]"
+                 << " [--idle-timeout=SECONDS] [--cache-mb=N] [--acceptors=N] [--workers=N]"
+                 << " [--max-connections=N] [--read-timeout=SECONDS] [--write-timeout=SECONDS]\n";
+            return 1;
+        }
+    }
+#ifndef __linux__
+    if (mode != "threads") {
+        cerr << "Mode '" << mode << "' is only available on Linux, using threads\n";
+        mode = "threads";
+    }
+#endif
+    if (mode != "epoll" && mode != "uring" && mode != "threads" && mode != "reuseport") {
+        cerr << "Unknown mode: " << mode << "\n";
+        return 1;
+    }
+    // Files above 1 MB are streamed with sendfile rather than cached
+    responseCache = make_unique<ResponseCache>((size_t)cacheMegabytes << 20, 1 << 20);
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);   // a client closing mid-send must not kill the server
+#endif
     cout << "--- Simple HTTP Web Server ---\n";
     cout << "Serving files from the current directory on http://localhost:" << port << "/\n";
+#ifdef __linux__
+    if (mode == "reuseport") {
+        cout << "Mode: SO_REUSEPORT (" << acceptors << " acceptors x " << workers << " workers, max "
+             << maxConnections << " connections)\n";
+        // Each acceptor may queue a few connections per worker before refusing
+        bool ok = runReusePort(port, acceptors, workers, workers * 4, maxConnections);
+        cleanupSockets();
+        return ok ? 0 : 1;
+    }
+#endif
 #ifdef _WIN32
     SOCKET server = socket(AF_INET, SOCK_STREAM, 0);
 #else
@@ -102,6 +1567,8 @@ int main() {
         cleanupSockets();
         return 1;
     }
+    int reuse = 1;   // allow quick restarts while old connections sit in TIME_WAIT
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
     sockaddr_in addr = {};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
@@ -111,13 +1578,33 @@ int main() {
         cleanupSockets();
         return 1;
     }
+#ifdef __linux__
+    if (mode == "uring") {
+        listen(server, SOMAXCONN);
+        cout << "Mode: io_uring (" << reactors << " reactor threads)\n";
+        if (runUringReactors(server, reactors)) {
+            cleanupSockets();
+            return 0;
+        }
+        cout << "Falling back to epoll\n";
+        mode = "epoll";
+    }
+    if (mode == "epoll") {
+        listen(server, SOMAXCONN);
+        cout << "Mode: epoll (" << reactors << " reactor threads)\n";
+        runReactors(server, reactors);
+        cleanupSockets();
+        return 0;
+    }
+#endif
+    cout << "Mode: thread per connection\n";
     listen(server, 5);
     while (true) {
         sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         SOCKET client = accept(server, (sockaddr*)&client_addr, &client_len);
         if (client == INVALID_SOCKET) continue;
-        thread(handle_client, client).detach();
+        thread(handle_client, client, chrono::steady_clock::now(), nullptr).detach();
     }
     cleanupSockets();
     return 0;
@@ -3,6 +3,12 @@
   ---------------------------------------------
   - Complete blockchain: block struct, hashing, proof-of-work mining, basic transactions
   - CLI simulation: create genesis, add blocks, validate chain
+  - Multi-threaded miner: nonce space striped across cores, hashrate reported per thread
+  - Fixed binary header hashed from a per-block SHA-256 midstate; difficulty in leading zero bits
+  - Merkle tree over each block's transactions: root in the header, O(log n) inclusion proofs
+  - Append-only block file + fixed-size index, mapped at startup; validation resumes from a checkpoint
+  - Parallel validation: hashes, proof of work and Merkle roots checked across threads, links in order
+  - Balance index updated per block; fee-ordered mempool with a memory budget and overdraft checks
   - Demonstrates hashing, immutability, and tampering detection (C++17, portable)
 */
 
@@ -12,98 +18,842 @@
 #include <sstream>
 #include <iomanip>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <openssl/sha.h>   // Linux: install libssl-dev, Windows: OpenSSL binaries
 using namespace std;
 
-// SHA-256 hash (using OpenSSL) as hex string
-string sha256(const string& s) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
+typedef array<unsigned char, SHA256_DIGEST_LENGTH> Hash256;
+
+// SHA-256 hash (using OpenSSL)
+Hash256 sha256(const string& s) {
+    Hash256 hash;
     SHA256_CTX sha256_ctx;
     SHA256_Init(&sha256_ctx);
     SHA256_Update(&sha256_ctx, s.c_str(), s.size());
-    SHA256_Final(hash, &sha256_ctx);
+    SHA256_Final(hash.data(), &sha256_ctx);
+    return hash;
+}
+
+string toHex(const Hash256& hash) {
     stringstream ss;
     for(int i = 0; i < SHA256_DIGEST_LENGTH; ++i)
         ss << hex << setw(2) << setfill('0') << (int)hash[i];
     return ss.str();
 }
 
-// Transaction structure (demo: from, to, amount)
+// Proof of work: the hash, read as a big-endian number, starts with at least
+// `bits` zero bits. One hex zero is four bits.
+bool meetsDifficulty(const Hash256& hash, int bits) {
+    int full = bits / 8;
+    for (int i = 0; i < full; i++)
+        if (hash[i]) return false;
+    int rest = bits % 8;
+    return rest == 0 || (hash[full] >> (8 - rest)) == 0;
+}
+
+// Little-endian so the header bytes are the same on every platform
+void putLE(unsigned char* out, unsigned long long v, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(v >> (8 * i));
+}
+
+unsigned long long getLE(const unsigned char* in, int bytes) {
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++) v |= (unsigned long long)in[i] << (8 * i);
+    return v;
+}
+
+// u16 length then the bytes; longer strings are cut at 65535
+void appendString(string& out, const string& s) {
+    size_t len = min(s.size(), (size_t)0xffff);
+    unsigned char n[2];
+    putLE(n, len, 2);
+    out.append((const char*)n, 2);
+    out.append(s, 0, len);
+}
+
+// The IEEE-754 bit pattern, so no digit of the value is lost
+void appendDouble(string& out, double v) {
+    unsigned long long bits;
+    memcpy(&bits, &v, 8);
+    unsigned char b[8];
+    putLE(b, bits, 8);
+    out.append((const char*)b, 8);
+}
+
+// Transaction structure (demo: from, to, amount, fee paid by `from` to the miner)
 struct Transaction {
     string from, to;
     double amount;
-    Transaction(const string& f, const string& t, double a)
-        : from(f), to(t), amount(a) {}
+    double fee;
+    Transaction(const string& f, const string& t, double a, double fee_ = 0)
+        : from(f), to(t), amount(a), fee(fee_) {}
     string toString() const {
         stringstream ss;
         ss << from << "->" << to << ":" << amount;
+        if (fee != 0) ss << "+" << fee;
         return ss.str();
     }
+    // Canonical bytes, hashed into the Merkle tree and stored by BlockStore:
+    // u16 len, from | u16 len, to | f64 amount | f64 fee. toString() rounds
+    // amounts and does not escape "->", so it is for display only.
+    void encode(string& out) const {
+        appendString(out, from);
+        appendString(out, to);
+        appendDouble(out, amount);
+        appendDouble(out, fee);
+    }
+};
+
+// Merkle tree over a block's transactions. Leaves are H(0x00 || tx) and inner
+// nodes H(0x01 || left || right), so a leaf can never pass for an inner node.
+// A node with no right sibling moves up a level unchanged instead of being
+// paired with a copy of itself, so two different transaction lists cannot
+// share a root. levels[0] holds the leaves and levels.back() the root.
+struct MerkleStep {
+    Hash256 sibling;
+    bool siblingOnLeft;
+};
+typedef vector<MerkleStep> MerkleProof;
+
+class MerkleTree {
+public:
+    MerkleTree() {}
+    explicit MerkleTree(const vector<Transaction>& txs) {
+        for (const auto& tx : txs) append(leafHash(tx));
+    }
+
+    static Hash256 leafHash(const Transaction& tx) {
+        string leaf(1, '\0');
+        tx.encode(leaf);
+        return sha256(leaf);
+    }
+
+    static Hash256 nodeHash(const Hash256& left, const Hash256& right) {
+        unsigned char buf[1 + 2 * SHA256_DIGEST_LENGTH];
+        buf[0] = 1;
+        memcpy(buf + 1, left.data(), SHA256_DIGEST_LENGTH);
+        memcpy(buf + 1 + SHA256_DIGEST_LENGTH, right.data(), SHA256_DIGEST_LENGTH);
+        Hash256 out;
+        SHA256(buf, sizeof(buf), out.data());
+        return out;
+    }
+
+    // Adds a leaf and recomputes only the nodes on its path to the root:
+    // O(log n) hashes instead of rebuilding the tree.
+    void append(const Hash256& leaf) {
+        if (levels.empty()) levels.emplace_back();
+        levels[0].push_back(leaf);
+        for (size_t l = 0; levels[l].size() > 1; l++) {
+            size_t i = levels[l].size() - 1;
+            Hash256 parent = i % 2 ? nodeHash(levels[l][i - 1], levels[l][i]) : levels[l][i];
+            if (levels.size() == l + 1) levels.emplace_back();
+            vector<Hash256>& up = levels[l + 1];
+            if (up.size() > i / 2) up[i / 2] = parent;
+            else up.push_back(parent);
+        }
+    }
+
+    size_t size() const { return levels.empty() ? 0 : levels[0].size(); }
+
+    // All zeros for a block without transactions
+    Hash256 root() const { return levels.empty() ? Hash256{} : levels.back()[0]; }
+
+    // Siblings from the leaf up; promoted levels contribute no step.
+    MerkleProof prove(size_t index) const {
+        MerkleProof proof;
+        for (size_t l = 0; l + 1 < levels.size(); l++, index /= 2) {
+            size_t sib = index ^ 1;
+            if (sib < levels[l].size()) proof.push_back({levels[l][sib], sib < index});
+        }
+        return proof;
+    }
+
+    static bool verify(const Hash256& leaf, const MerkleProof& proof, const Hash256& root) {
+        Hash256 h = leaf;
+        for (const auto& step : proof)
+            h = step.siblingOnLeft ? nodeHash(step.sibling, h) : nodeHash(h, step.sibling);
+        return h == root;
+    }
+
+private:
+    vector<vector<Hash256>> levels;
+};
+
+// Hashes tried by one miner thread
+struct MinerThreadStats {
+    unsigned long long hashes = 0;
+    double seconds = 0;
+};
+
+struct MiningStats {
+    vector<MinerThreadStats> threads;
+    double seconds = 0;
+    unsigned long long totalHashes() const {
+        unsigned long long n = 0;
+        for (const auto& t : threads) n += t.hashes;
+        return n;
+    }
 };
 
+// Block header layout (88 bytes, little-endian):
+//   0  u32 index | 4  u32 bits | 8  u64 timestamp | 16  prevHash[32] | 48  merkleRoot[32] | 80  u64 nonce
+// bits is the difficulty the block was mined at, so validation can check its
+// proof of work. Only the nonce changes while mining and it sits last, so
+// SHA-256 over the first 80 bytes (its first 64-byte block compressed, the
+// rest buffered) is taken once per block and each attempt only hashes the
+// 8-byte tail.
+const size_t HEADER_SIZE = 88;
+const size_t NONCE_OFFSET = 80;
+
 // Block structure
 struct Block {
     int index;
+    int bits;             // leading zero bits the hash must have
     time_t timestamp;
     vector<Transaction> txs;
-    string prevHash;
-    string hash;
-    int nonce;
+    Hash256 prevHash;
+    Hash256 merkleRoot;   // commits the header to txs
+    Hash256 hash;
+    long long nonce;
+    MerkleTree tree;
 
-    Block(int idx, vector<Transaction> txs_, const string& prev)
-        : index(idx), timestamp(time(nullptr)), txs(move(txs_)), prevHash(prev), hash(""), nonce(0) {}
+    Block(int idx, vector<Transaction> txs_, const Hash256& prev)
+        : index(idx), bits(0), timestamp(time(nullptr)), txs(move(txs_)), prevHash(prev), hash(), nonce(0),
+          tree(txs) {
+        merkleRoot = tree.root();
+    }
 
-    string calcHash() const {
-        stringstream ss;
-        ss << index << timestamp << prevHash << nonce;
-        for(const auto& tx : txs) ss << tx.toString();
-        return sha256(ss.str());
+    // Empty block for BlockStore to decode into
+    Block() : index(0), bits(0), timestamp(0), prevHash(), merkleRoot(), hash(), nonce(0) {}
+
+    // For a block still being built: updates the root in O(log n).
+    void addTransaction(const Transaction& tx) {
+        txs.push_back(tx);
+        tree.append(MerkleTree::leafHash(tx));
+        merkleRoot = tree.root();
+    }
+
+    // Blocks loaded from disk skip building the tree until a proof is asked for
+    MerkleProof proveTransaction(size_t i) const {
+        return tree.size() == txs.size() ? tree.prove(i) : MerkleTree(txs).prove(i);
+    }
+
+    // True when txs still hash to the root recorded in the header
+    bool transactionsMatchRoot() const { return MerkleTree(txs).root() == merkleRoot; }
+
+    void writeHeader(unsigned char out[HEADER_SIZE]) const {
+        putLE(out, (unsigned)index, 4);
+        putLE(out + 4, (unsigned)bits, 4);
+        putLE(out + 8, (unsigned long long)timestamp, 8);
+        memcpy(out + 16, prevHash.data(), 32);
+        memcpy(out + 48, merkleRoot.data(), 32);
+        putLE(out + NONCE_OFFSET, (unsigned long long)nonce, 8);
     }
 
-    void mine(int difficulty) {
-        string prefix(difficulty, '0');
-        do {
-            nonce++;
-            hash = calcHash();
-        } while (hash.substr(0, difficulty) != prefix);
+    void readHeader(const unsigned char in[HEADER_SIZE]) {
+        index = (int)getLE(in, 4);
+        bits = (int)getLE(in + 4, 4);
+        timestamp = (time_t)getLE(in + 8, 8);
+        memcpy(prevHash.data(), in + 16, 32);
+        memcpy(merkleRoot.data(), in + 48, 32);
+        nonce = (long long)getLE(in + NONCE_OFFSET, 8);
+    }
+
+    // SHA-256 state after the constant part of the header
+    void midstate(SHA256_CTX& ctx) const {
+        unsigned char header[HEADER_SIZE];
+        writeHeader(header);
+        SHA256_Init(&ctx);
+        SHA256_Update(&ctx, header, NONCE_OFFSET);
+    }
+
+    static Hash256 finishHash(const SHA256_CTX& mid, long long n) {
+        SHA256_CTX ctx = mid;
+        unsigned char tail[HEADER_SIZE - NONCE_OFFSET];
+        putLE(tail, (unsigned long long)n, 8);
+        SHA256_Update(&ctx, tail, sizeof(tail));
+        Hash256 out;
+        SHA256_Final(out.data(), &ctx);
+        return out;
+    }
+
+    Hash256 calcHash() const {
+        SHA256_CTX mid;
+        midstate(mid);
+        return finishHash(mid, nonce);
+    }
+
+    // Thread t tries nonces t+1, t+1+T, t+1+2T, ... A thread that finds a
+    // valid nonce lowers `best`, and every thread stops once its next nonce
+    // would exceed it, so the result is the lowest valid nonce: the same block
+    // the single-threaded loop would produce, just found sooner.
+    MiningStats mine(int difficulty, int threadCount = 0) {
+        if (threadCount <= 0) threadCount = max(1u, thread::hardware_concurrency());
+        bits = difficulty;
+        SHA256_CTX mid;
+        midstate(mid);
+        atomic<long long> best{-1};
+        MiningStats stats;
+        stats.threads.resize(threadCount);
+        auto start = chrono::steady_clock::now();
+
+        auto worker = [&](int t) {
+            MinerThreadStats& own = stats.threads[t];
+            auto begin = chrono::steady_clock::now();
+            for (long long n = t + 1;; n += threadCount) {
+                long long found = best.load(memory_order_relaxed);
+                if (found != -1 && n > found) break;
+                own.hashes++;
+                if (!meetsDifficulty(finishHash(mid, n), difficulty)) continue;
+                // Keep the smallest winner if several threads hit at once
+                while (found == -1 || n < found)
+                    if (best.compare_exchange_weak(found, n)) break;
+                break;
+            }
+            own.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threadCount; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& th : pool) th.join();
+
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        nonce = best.load();
+        hash = calcHash();
+        return stats;
     }
 };
 
+void printMiningStats(const MiningStats& stats) {
+    ios oldState(nullptr);
+    oldState.copyfmt(cout);
+    for (size_t t = 0; t < stats.threads.size(); t++) {
+        const auto& th = stats.threads[t];
+        cout << "  thread " << t << ": " << th.hashes << " hashes, "
+             << fixed << setprecision(1) << (th.seconds > 0 ? th.hashes / th.seconds / 1000 : 0) << " kH/s\n";
+    }
+    cout << "  total:    " << stats.totalHashes() << " hashes in " << setprecision(3) << stats.seconds << " s, "
+         << setprecision(1) << (stats.seconds > 0 ? stats.totalHashes() / stats.seconds / 1000 : 0) << " kH/s\n";
+    cout.copyfmt(oldState);
+}
+
+// Read-only view of a whole file: mmap on POSIX, a plain read elsewhere.
+class MappedFile {
+public:
+    ~MappedFile() { close(); }
+
+    // A missing file opens as empty
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        ifstream in(path, ios::binary);
+        if (!in) return true;
+        buf.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        ptr = (const unsigned char*)buf.data();
+        len = buf.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return errno == ENOENT;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                ptr = (const unsigned char*)m;
+                len = st.st_size;
+                madvise(m, len, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+        if (st.st_size > 0 && !ptr) return false;
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        buf.clear();
+#else
+        if (ptr) munmap((void*)ptr, len);
+#endif
+        ptr = nullptr;
+        len = 0;
+    }
+
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+#ifdef _WIN32
+    vector<char> buf;
+#endif
+    const unsigned char* ptr = nullptr;
+    size_t len = 0;
+};
+
+// On-disk chain, all little-endian, in one directory:
+//   blocks.dat   "SBC" 0x01 | u32 difficulty, then append-only records:
+//                header[88] | u32 txCount | txCount x Transaction::encode()
+//   blocks.idx   one 48-byte entry per height: u64 offset | u32 size | u32 0 | hash[32]
+//   checkpoint   u64 height | hash[32] of the last block that passed isValid
+// A block is written before its index entry, so after a crash the index
+// never points past the data. Opening maps both files, decodes the blocks
+// without hashing anything, takes each block's hash from the index, and cuts
+// off a torn tail. The difficulty is fixed when the store is created and
+// every later open validates against it, whatever was asked for.
+class BlockStore {
+public:
+    static const size_t FILE_HEADER_SIZE = 8;
+    static const size_t INDEX_ENTRY_SIZE = 48;
+
+    explicit BlockStore(const string& dir_) : dir(dir_) {}
+
+    // A new store records `difficulty`; an existing one replaces it with its own
+    bool open(vector<Block>& chain, size_t& validatedHeight, int& difficulty) {
+        error_code ec;
+        filesystem::create_directories(dir, ec);
+        if (ec) {
+            cerr << "Cannot create " << dir << ": " << ec.message() << "\n";
+            return false;
+        }
+        MappedFile blockFile, indexFile;
+        if (!blockFile.open(path("blocks.dat")) || !indexFile.open(path("blocks.idx"))) {
+            cerr << "Cannot map the block store in " << dir << "\n";
+            return false;
+        }
+
+        size_t count = indexFile.size() / INDEX_ENTRY_SIZE;
+        // No blocks and no complete file header: nothing is lost by starting over
+        bool fresh = count == 0 && blockFile.size() < FILE_HEADER_SIZE;
+        if (!fresh) {
+            bool readable = blockFile.size() >= FILE_HEADER_SIZE && memcmp(blockFile.data(), MAGIC, 4) == 0;
+            int stored = readable ? (int)getLE(blockFile.data() + 4, 4) : 0;
+            if (stored < 1 || stored > 256) {
+                cerr << dir << " does not hold a block store this version can read\n";
+                return false;
+            }
+            difficulty = stored;
+        }
+        chain.clear();
+        chain.reserve(count);
+        dataSize = FILE_HEADER_SIZE;
+        for (size_t h = 0; h < count; h++) {
+            const unsigned char* entry = indexFile.data() + h * INDEX_ENTRY_SIZE;
+            unsigned long long offset = getLE(entry, 8), size = getLE(entry + 8, 4);
+            Block blk;
+            if (offset != dataSize || offset + size > blockFile.size() ||
+                !decode(blockFile.data() + offset, size, blk) || blk.index != (int)h)
+                break;
+            memcpy(blk.hash.data(), entry + 16, 32);
+            chain.push_back(move(blk));
+            dataSize = offset + size;
+        }
+        blockFile.close();
+        indexFile.close();
+        // A crash can only tear the tail; an unreadable first block means the
+        // files are not a chain in this format, so leave them alone.
+        if (count > 0 && chain.empty()) {
+            cerr << dir << " does not hold a block store this version can read\n";
+            return false;
+        }
+
+        // Drop whatever a crash left past the last complete block
+        filesystem::resize_file(path("blocks.dat"), fresh ? 0 : dataSize, ec);
+        filesystem::resize_file(path("blocks.idx"), chain.size() * INDEX_ENTRY_SIZE, ec);
+
+        validatedHeight = 0;
+        ifstream cp(path("checkpoint"), ios::binary);
+        unsigned char buf[8 + 32];
+        if (cp.read((char*)buf, sizeof(buf))) {
+            size_t height = (size_t)getLE(buf, 8);
+            if (height < chain.size() && memcmp(chain[height].hash.data(), buf + 8, 32) == 0)
+                validatedHeight = height;
+        }
+
+        blocks.open(path("blocks.dat"), ios::binary | ios::app);
+        index.open(path("blocks.idx"), ios::binary | ios::app);
+        if (fresh) {
+            unsigned char header[FILE_HEADER_SIZE];
+            memcpy(header, MAGIC, 4);
+            putLE(header + 4, (unsigned)difficulty, 4);
+            blocks.write((const char*)header, sizeof(header));
+            blocks.flush();
+        }
+        return blocks && index;
+    }
+
+    bool append(const Block& blk) {
+        string rec = encode(blk);
+        unsigned char entry[INDEX_ENTRY_SIZE] = {};
+        putLE(entry, dataSize, 8);
+        putLE(entry + 8, rec.size(), 4);
+        memcpy(entry + 16, blk.hash.data(), 32);
+        blocks.write(rec.data(), rec.size());
+        blocks.flush();
+        index.write((const char*)entry, sizeof(entry));
+        index.flush();
+        if (!blocks || !index) {
+            cerr << "Failed to write block #" << blk.index << " to " << dir << "\n";
+            return false;
+        }
+        dataSize += rec.size();
+        return true;
+    }
+
+    // Written to a temporary file and renamed so a crash leaves the old one
+    void saveCheckpoint(size_t height, const Hash256& hash) {
+        unsigned char buf[8 + 32];
+        putLE(buf, height, 8);
+        memcpy(buf + 8, hash.data(), 32);
+        {
+            ofstream out(path("checkpoint.tmp"), ios::binary | ios::trunc);
+            out.write((const char*)buf, sizeof(buf));
+            if (!out.flush()) return;
+        }
+        error_code ec;
+        filesystem::rename(path("checkpoint.tmp"), path("checkpoint"), ec);
+    }
+
+    static string encode(const Block& blk) {
+        string rec(HEADER_SIZE + 4, '\0');
+        blk.writeHeader((unsigned char*)&rec[0]);
+        putLE((unsigned char*)&rec[HEADER_SIZE], blk.txs.size(), 4);
+        for (const auto& tx : blk.txs) tx.encode(rec);
+        return rec;
+    }
+
+    static bool decode(const unsigned char* p, size_t size, Block& blk) {
+        if (size < HEADER_SIZE + 4) return false;
+        blk.readHeader(p);
+        size_t count = (size_t)getLE(p + HEADER_SIZE, 4), pos = HEADER_SIZE + 4;
+        blk.txs.clear();
+        blk.txs.reserve(min(count, size / 20));
+        for (size_t i = 0; i < count; i++) {
+            string from, to;
+            double amount, fee;
+            if (!readString(p, size, pos, from) || !readString(p, size, pos, to) ||
+                !readDouble(p, size, pos, amount) || !readDouble(p, size, pos, fee))
+                return false;
+            blk.txs.emplace_back(from, to, amount, fee);
+        }
+        return pos == size;
+    }
+
+private:
+    static constexpr const char* MAGIC = "SBC\x01";
+
+    string path(const char* name) const { return (filesystem::path(dir) / name).string(); }
+
+    static bool readDouble(const unsigned char* p, size_t size, size_t& pos, double& v) {
+        if (pos + 8 > size) return false;
+        unsigned long long bits = getLE(p + pos, 8);
+        memcpy(&v, &bits, 8);
+        pos += 8;
+        return true;
+    }
+
+    static bool readString(const unsigned char* p, size_t size, size_t& pos, string& s) {
+        if (pos + 2 > size) return false;
+        size_t len = (size_t)getLE(p + pos, 2);
+        if (pos + 2 + len > size) return false;
+        s.assign((const char*)p + pos + 2, len);
+        pos += 2 + len;
+        return true;
+    }
+
+    string dir;
+    ofstream blocks, index;
+    unsigned long long dataSize = 0;
+};
+
+// Account that issues new coins: the genesis grant and each block's fee
+// payout to its miner. It has no balance and is never checked.
+const string ISSUER = "network";
+
+// Confirmed balance of every account, updated one block at a time, so a
+// balance query or an overdraft check is one hash lookup instead of a scan
+// over every block's txs.
+class BalanceIndex {
+public:
+    void apply(const Block& blk) {
+        for (const auto& tx : blk.txs) {
+            if (tx.from != ISSUER) balances[tx.from] -= tx.amount + tx.fee;
+            balances[tx.to] += tx.amount;
+        }
+    }
+
+    double balance(const string& account) const {
+        auto it = balances.find(account);
+        return it == balances.end() ? 0 : it->second;
+    }
+
+private:
+    unordered_map<string, double> balances;
+};
+
+enum class AdmitResult { Accepted, Invalid, InsufficientFunds, FeeTooLow };
+
+// Pending transactions ordered by fee; among equal fees the older one ranks
+// higher. Admission charges amount + fee against the sender's confirmed
+// balance minus what the sender already has pending, so a double spend is
+// rejected on arrival in O(1). The pool holds at most `budget` bytes: a new
+// transaction may evict strictly cheaper ones from the bottom, otherwise it is
+// turned away. Insert, evict and take are O(log n).
+class Mempool {
+public:
+    explicit Mempool(size_t budgetBytes) : budget(budgetBytes) {}
+
+    AdmitResult add(const Transaction& tx, const BalanceIndex& balances) {
+        if (!(tx.amount > 0) || !(tx.fee >= 0) || tx.from == tx.to || tx.from == ISSUER) return AdmitResult::Invalid;
+        auto pending = pendingSpend.find(tx.from);
+        double available = balances.balance(tx.from) - (pending == pendingSpend.end() ? 0 : pending->second);
+        if (available < tx.amount + tx.fee) return AdmitResult::InsufficientFunds;
+
+        size_t need = footprint(tx);
+        if (need > budget) return AdmitResult::FeeTooLow;
+        // Make sure enough strictly cheaper entries exist before evicting any
+        size_t freed = 0;
+        for (auto it = byFee.begin(); used - freed + need > budget; ++it) {
+            if (it == byFee.end() || it->first.fee >= tx.fee) return AdmitResult::FeeTooLow;
+            freed += footprint(it->second);
+        }
+        while (used + need > budget) remove(byFee.begin());
+
+        byFee.emplace(Key{tx.fee, nextSeq++}, tx);
+        pendingSpend[tx.from] += tx.amount + tx.fee;
+        used += need;
+        return AdmitResult::Accepted;
+    }
+
+    // Removes and returns up to maxCount transactions, highest fee first
+    vector<Transaction> takeBest(size_t maxCount) {
+        vector<Transaction> out;
+        while (out.size() < maxCount && !byFee.empty()) {
+            auto top = prev(byFee.end());
+            out.push_back(top->second);
+            remove(top);
+        }
+        return out;
+    }
+
+    size_t size() const { return byFee.size(); }
+    size_t bytes() const { return used; }
+
+    void print() const {
+        cout << byFee.size() << " pending, " << used << " of " << budget << " bytes\n";
+        for (auto it = byFee.rbegin(); it != byFee.rend(); ++it)
+            cout << "  fee " << it->second.fee << "  " << it->second.from << " --> " << it->second.to
+                 << " : " << it->second.amount << "\n";
+    }
+
+private:
+    struct Key {
+        double fee;
+        unsigned long long seq;
+        bool operator<(const Key& o) const { return fee != o.fee ? fee < o.fee : seq > o.seq; }
+    };
+
+    // Rough heap cost of one entry: the map node plus both strings
+    static size_t footprint(const Transaction& tx) {
+        return sizeof(Key) + sizeof(Transaction) + 4 * sizeof(void*) + tx.from.size() + tx.to.size();
+    }
+
+    void remove(map<Key, Transaction>::iterator it) {
+        const Transaction& tx = it->second;
+        auto pending = pendingSpend.find(tx.from);
+        pending->second -= tx.amount + tx.fee;
+        if (pending->second <= 1e-9) pendingSpend.erase(pending);
+        used -= footprint(tx);
+        byFee.erase(it);
+    }
+
+    map<Key, Transaction> byFee;
+    unordered_map<string, double> pendingSpend;
+    size_t budget;
+    size_t used = 0;
+    unsigned long long nextSeq = 0;
+};
+
 // Blockchain class
 struct Blockchain {
     vector<Block> chain;
-    int difficulty = 4;   // # of leading zeros required in hash
+    int difficulty = 16;  // # of leading zero bits required in hash; a stored chain keeps its own
+    int minerThreads = 0; // 0 = one per core
+    size_t validatedHeight = 0;      // blocks up to here already passed isValid
+    unique_ptr<BlockStore> store;    // null keeps the chain in memory only
+    BalanceIndex balances;           // confirmed balances as of chain.back()
 
-    Blockchain() {        // Genesis block
-        vector<Transaction> genesisTx = {Transaction("network", "satoshi", 50)};
-        Block genesis(0, genesisTx, "0");
-        genesis.mine(difficulty);
-        genesis.hash = genesis.calcHash();
+    Blockchain(int difficulty_ = 16, int minerThreads_ = 0, const string& dataDir = "")
+        : difficulty(difficulty_), minerThreads(minerThreads_) {
+        if (!dataDir.empty()) {
+            auto start = chrono::steady_clock::now();
+            store = make_unique<BlockStore>(dataDir);
+            int requested = difficulty;
+            if (!store->open(chain, validatedHeight, difficulty)) {
+                cerr << "Block store unavailable, keeping the chain in memory\n";
+                store.reset();
+                chain.clear();
+                difficulty = requested;
+            } else {
+                if (difficulty != requested)
+                    cout << "Chain in " << dataDir << " was created at " << difficulty << " bits; using that instead of "
+                         << requested << "\n";
+                if (!chain.empty()) {
+                    for (const auto& blk : chain) balances.apply(blk);
+                    cout << "Opened " << chain.size() << " blocks from " << dataDir << " in "
+                         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+                         << " ms (validated through #" << validatedHeight << ")\n";
+                    return;
+                }
+            }
+        }
+        // Genesis block
+        vector<Transaction> genesisTx = {Transaction(ISSUER, "satoshi", 50)};
+        Block genesis(0, genesisTx, Hash256{});
+        genesis.mine(difficulty, minerThreads);
         chain.push_back(genesis);
+        balances.apply(genesis);
+        if (store) store->append(genesis);
     }
 
     void addBlock(const vector<Transaction>& txs) {
         int nextIdx = chain.size();
-        string prevHash = chain.back().hash;
-        Block blk(nextIdx, txs, prevHash);
+        Hash256 prevHash = chain.back().hash;
+        Block blk(nextIdx, {}, prevHash);
+        for (const auto& tx : txs) blk.addTransaction(tx);
         cout << "Mining block " << nextIdx << "...\n";
-        blk.mine(difficulty);
+        printMiningStats(blk.mine(difficulty, minerThreads));
         chain.push_back(blk);
+        balances.apply(chain.back());
+        if (store) store->append(chain.back());
     }
 
-    bool isValid() const {
-        for(size_t i=1; i < chain.size(); ++i) {
-            const Block& curr = chain[i];
-            const Block& prev = chain[i-1];
-            if(curr.hash != curr.calcHash()) {
-                cout << "Block #" << i << " has invalid hash!\n";
-                return false;
-            }
-            if(curr.prevHash != prev.hash) {
-                cout << "Block #" << i << "'s prevHash is invalid!\n";
-                return false;
+    // Mines the best-paying pending transactions into a block, led by a
+    // payout of their fees from the issuer to `miner`.
+    bool mineFromMempool(Mempool& pool, size_t maxTxs, const string& miner) {
+        vector<Transaction> txs = pool.takeBest(maxTxs);
+        if (txs.empty()) {
+            cout << "Mempool is empty.\n";
+            return false;
+        }
+        double fees = 0;
+        for (const auto& tx : txs) fees += tx.fee;
+        if (fees > 0) txs.insert(txs.begin(), Transaction(ISSUER, miner, fees));
+        addBlock(txs);
+        return true;
+    }
+
+    // A block changed in memory invalidates the checkpoint from there on
+    void markModified(size_t idx) {
+        if (idx <= validatedHeight) validatedHeight = idx ? idx - 1 : 0;
+    }
+
+    // Reasons a block fails, in the order a serial walk would report them
+    enum class Fault { None, Hash, Link, Merkle, Work };
+
+    // Everything that depends on the block alone, so blocks can be checked
+    // in any order. The prevHash link is checked separately. A block's bits
+    // come from its own header, so they must be at least the chain's
+    // difficulty (the store's, for a stored chain) and no more than a hash holds.
+    Fault checkContents(const Block& blk) const {
+        if (blk.hash != blk.calcHash()) return Fault::Hash;
+        if (!blk.transactionsMatchRoot()) return Fault::Merkle;
+        if (blk.bits < difficulty || blk.bits > 256 || !meetsDifficulty(blk.hash, blk.bits)) return Fault::Work;
+        return Fault::None;
+    }
+
+    // Worker threads pull fixed-size ranges of heights from a shared counter
+    // and check their contents. The lowest failing height seen so far is kept
+    // in an atomic, and no range above it is started. Ranges are handed out in
+    // order, so every block below the final minimum has been checked and the
+    // answer does not depend on scheduling. A serial pass over the prevHash
+    // links up to that height then picks whichever failure comes first.
+    pair<size_t, Fault> findFirstFault(size_t from) const {
+        const size_t RANGE = 64;
+        size_t n = chain.size();
+        int threadCount = minerThreads > 0 ? minerThreads : max(1u, thread::hardware_concurrency());
+        threadCount = (int)min<size_t>(threadCount, (n - from + RANGE - 1) / RANGE);
+        atomic<size_t> next{from}, firstBad{n};
+        vector<pair<size_t, Fault>> found(max(threadCount, 1), {n, Fault::None});
+
+        auto worker = [&](int t) {
+            for (;;) {
+                size_t lo = next.fetch_add(RANGE);
+                if (lo >= n || lo >= firstBad.load()) return;
+                for (size_t i = lo; i < min(lo + RANGE, n) && i < firstBad.load(); i++) {
+                    Fault f = checkContents(chain[i]);
+                    if (f == Fault::None) continue;
+                    found[t] = {i, f};
+                    size_t cur = firstBad.load();
+                    while (i < cur && !firstBad.compare_exchange_weak(cur, i)) {}
+                    return;   // later blocks of this thread are all above i
+                }
             }
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threadCount; t++) pool.emplace_back(worker, t);
+        if (threadCount > 0) worker(0);
+        for (auto& th : pool) th.join();
+
+        pair<size_t, Fault> first = {n, Fault::None};
+        for (const auto& f : found)
+            if (f.first < first.first) first = f;
+        for (size_t i = from; i < n && i <= first.first; i++) {
+            if (chain[i].prevHash == chain[i - 1].hash) continue;
+            // The hash check comes before the link for the same block
+            if (i < first.first || first.second != Fault::Hash) first = {i, Fault::Link};
+            break;
+        }
+        return first;
+    }
+
+    // Starts after the checkpoint; blocks at or below it were already checked.
+    bool isValid() {
+        if (validatedHeight > 0)
+            cout << "Resuming validation after checkpoint #" << validatedHeight << "\n";
+        auto start = chrono::steady_clock::now();
+        pair<size_t, Fault> fault = findFirstFault(validatedHeight + 1);
+        size_t i = fault.first;
+        switch (fault.second) {
+        case Fault::None:
+            break;
+        case Fault::Hash:
+            cout << "Block #" << i << " has invalid hash!\n";
+            return false;
+        case Fault::Link:
+            cout << "Block #" << i << "'s prevHash is invalid!\n";
+            return false;
+        case Fault::Merkle:
+            cout << "Block #" << i << "'s transactions do not match its Merkle root!\n";
+            return false;
+        case Fault::Work:
+            if (chain[i].bits < difficulty || chain[i].bits > 256)
+                cout << "Block #" << i << " declares " << chain[i].bits << " bits of work; this chain needs "
+                     << difficulty << " to 256!\n";
+            else
+                cout << "Block #" << i << "'s hash does not meet its difficulty of " << chain[i].bits << " bits!\n";
+            return false;
         }
+        cout << "Checked " << chain.size() - validatedHeight - 1 << " blocks in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms\n";
+        validatedHeight = chain.size() - 1;
+        if (store) store->saveCheckpoint(validatedHeight, chain.back().hash);
         return true;
     }
 
@@ -112,40 +862,210 @@ struct Blockchain {
         for(const auto& blk : chain) {
             cout << "Block #" << blk.index << "\n";
             cout << "  Timestamp: " << ctime(&blk.timestamp);
-            cout << "  PrevHash:  " << blk.prevHash << "\n";
-            cout << "  Hash:      " << blk.hash << "\n";
-            cout << "  Nonce:     " << blk.nonce << "\n";
+            cout << "  PrevHash:  " << toHex(blk.prevHash) << "\n";
+            cout << "  Hash:      " << toHex(blk.hash) << "\n";
+            cout << "  Merkle:    " << toHex(blk.merkleRoot) << "\n";
+            cout << "  Nonce:     " << blk.nonce << " (" << blk.bits << " bits)\n";
             cout << "  TXs:\n";
-            for(const auto& tx : blk.txs)
-                cout << "    " << tx.from << " --> " << tx.to << " : " << tx.amount << "\n";
+            for(const auto& tx : blk.txs) {
+                cout << "    " << tx.from << " --> " << tx.to << " : " << tx.amount;
+                if (tx.fee != 0) cout << " (fee " << tx.fee << ")";
+                cout << "\n";
+            }
             cout << "\n";
         }
     }
 };
 
+// Single-thread hashes/sec of the old per-attempt path (stringstream over
+// every field and transaction, hex digest, compare the hex prefix) against the
+// midstate path, over the same block.
+void runHashBenchmark(long long attempts) {
+    vector<Transaction> txs;
+    for (int i = 0; i < 8; i++) txs.emplace_back("alice" + to_string(i), "bob" + to_string(i), 10.5 + i);
+    Block blk(1, txs, sha256("previous block"));
+    string prevHex = toHex(blk.prevHash), zeros(4, '0');
+    volatile int hits = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (long long n = 0; n < attempts; n++) {
+        stringstream ss;
+        ss << blk.index << blk.timestamp << prevHex << n;
+        for (const auto& tx : blk.txs) ss << tx.toString();
+        if (toHex(sha256(ss.str())).substr(0, 4) == zeros) hits = hits + 1;
+    }
+    double before = attempts / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    SHA256_CTX mid;
+    blk.midstate(mid);
+    for (long long n = 0; n < attempts; n++)
+        if (meetsDifficulty(Block::finishHash(mid, n), 16)) hits = hits + 1;
+    double after = attempts / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << fixed << setprecision(1);
+    cout << "string header + hex compare: " << before / 1000 << " kH/s\n";
+    cout << "binary header + midstate:    " << after / 1000 << " kH/s\n";
+    cout << "speedup:                     " << after / before << "x\n";
+}
+
+// Checks that transactions which print alike still get different Merkle
+// roots, then builds a small in-memory chain and appends blocks that must fail
+// validation with Fault::Work, then reopens a stored chain with other
+// --difficulty values. Returns the number of failed checks.
+int runValidationSelfTest() {
+    const int difficulty = 8;
+    int failures = 0;
+    auto expect = [&](const string& name, bool ok) {
+        cout << (ok ? "PASS  " : "FAIL  ") << name << "\n";
+        if (!ok) failures++;
+    };
+    auto distinctRoots = [](const Transaction& a, const Transaction& b) {
+        return a.toString() == b.toString() &&
+               MerkleTree(vector<Transaction>{a}).root() != MerkleTree(vector<Transaction>{b}).root();
+    };
+    expect("amounts differing past the 6th digit get different roots",
+           distinctRoots(Transaction("a", "b", 1234567), Transaction("a", "b", 1234568)) &&
+           distinctRoots(Transaction("a", "b", 0.1234567), Transaction("a", "b", 0.1234568)));
+    expect("accounts containing \"->\" get different roots",
+           distinctRoots(Transaction("a->b", "c", 1), Transaction("a", "b->c", 1)));
+
+    // A block on top of chain's tip declaring `bits`, mined at minedAt bits (0 = not mined)
+    auto forge = [](const Blockchain& bc, int bits, int minedAt) {
+        Block blk((int)bc.chain.size(), {Transaction("alice", "bob", 1)}, bc.chain.back().hash);
+        if (minedAt > 0) blk.mine(minedAt, 1);
+        blk.bits = bits;
+        blk.hash = blk.calcHash();
+        return blk;
+    };
+
+    Blockchain bc(difficulty, 1, "");
+    for (int i = 0; i < 3; i++) {
+        Block blk((int)bc.chain.size(), {Transaction("alice", "bob", i + 1.0)}, bc.chain.back().hash);
+        blk.mine(difficulty, 1);
+        bc.chain.push_back(blk);
+    }
+    expect("honestly mined chain is valid", bc.findFirstFault(1).second == Blockchain::Fault::None);
+
+    struct Case {
+        const char* name;
+        int bits, minedAt;
+    } cases[] = {
+        {"block declaring 0 bits is rejected", 0, 0},
+        {"block declaring negative bits is rejected", -8, 0},
+        {"block declaring fewer bits than the chain's difficulty is rejected", difficulty - 4, difficulty - 4},
+        {"block declaring more bits than a hash holds is rejected", 300, 0},
+    };
+    for (const Case& c : cases) {
+        bc.chain.push_back(forge(bc, c.bits, c.minedAt));
+        pair<size_t, Blockchain::Fault> fault = bc.findFirstFault(1);
+        expect(c.name, fault.first == bc.chain.size() - 1 && fault.second == Blockchain::Fault::Work);
+        bc.chain.pop_back();
+    }
+    expect("chain is valid again without the forged block", bc.findFirstFault(1).second == Blockchain::Fault::None);
+
+    // Reopening with a different flag must not change what is valid
+    string dir = (filesystem::temp_directory_path() /
+                  ("blockchain_selftest_" + to_string(chrono::steady_clock::now().time_since_epoch().count())))
+                     .string();
+    {
+        Blockchain created(difficulty, 1, dir);
+        Block blk(1, {Transaction("satoshi", "alice", 1)}, created.chain.back().hash);
+        blk.mine(difficulty, 1);
+        created.chain.push_back(blk);
+        if (created.store) created.store->append(blk);
+    }
+    {
+        Blockchain stricter(difficulty + 4, 1, dir);
+        expect("stored chain reopened with a higher --difficulty stays valid",
+               stricter.store && stricter.difficulty == difficulty &&
+                   stricter.findFirstFault(1).second == Blockchain::Fault::None);
+    }
+    {
+        Blockchain looser(difficulty - 4, 1, dir);
+        looser.chain.push_back(forge(looser, difficulty - 4, difficulty - 4));
+        pair<size_t, Blockchain::Fault> fault = looser.findFirstFault(1);
+        expect("stored chain reopened with a lower --difficulty still rejects easier blocks",
+               looser.store && fault.first == 2 && fault.second == Blockchain::Fault::Work);
+    }
+    error_code ec;
+    filesystem::remove_all(dir, ec);
+    return failures;
+}
+
 // CLI demo
-int main() {
-    Blockchain myChain;
+// Usage: main [--difficulty=BITS] [--threads=N] [--data-dir=DIR] [--miner=NAME]
+//             [--mempool-kb=N] [--block-txs=N]
+//        main --bench[=ATTEMPTS]   compare single-thread hash rates and exit
+//        main --self-test          check Merkle leaves and that validation rejects forged blocks
+// The chain is kept in DIR (default blockchain_data); an empty --data-dir=
+// keeps it in memory only. Fees of mined blocks are paid to NAME.
+int main(int argc, char* argv[]) {
+    int difficulty = 16, threads = 0;
+    string dataDir = "blockchain_data", miner = "miner";
+    size_t mempoolBytes = 1 << 20, blockTxs = 100;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--difficulty=", 0) == 0) difficulty = min(255, max(1, atoi(arg.c_str() + 13)));
+        else if (arg.rfind("--threads=", 0) == 0) threads = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--data-dir=", 0) == 0) dataDir = arg.substr(11);
+        else if (arg.rfind("--miner=", 0) == 0) miner = arg.substr(8);
+        else if (arg.rfind("--mempool-kb=", 0) == 0) mempoolBytes = (size_t)max(1, atoi(arg.c_str() + 13)) * 1024;
+        else if (arg.rfind("--block-txs=", 0) == 0) blockTxs = max(1, atoi(arg.c_str() + 12));
+        else if (arg == "--bench" || arg.rfind("--bench=", 0) == 0) {
+            runHashBenchmark(arg.size() > 8 ? max(1LL, atoll(arg.c_str() + 8)) : 500000);
+            return 0;
+        }
+        else if (arg == "--self-test") return runValidationSelfTest() ? 1 : 0;
+        else {
+            cerr << "Usage: " << argv[0] << " [--difficulty=BITS] [--threads=N] [--data-dir=DIR] [--miner=NAME]"
+                 << " [--mempool-kb=N] [--block-txs=N] | --bench[=ATTEMPTS] | --self-test\n";
+            return 1;
+        }
+    }
+    Blockchain myChain(difficulty, threads, dataDir);
+    Mempool mempool(mempoolBytes);
     string cmd;
+
+    // Reads one transaction from the prompt and offers it to the mempool
+    auto submit = [&](const string& label) {
+        string from, to; double amt, fee;
+        cout << label << " from: "; cin >> from;
+        cout << "      to: "; cin >> to;
+        cout << "      amount: "; cin >> amt;
+        cout << "      fee: "; cin >> fee;
+        switch (mempool.add(Transaction(from, to, amt, fee), myChain.balances)) {
+        case AdmitResult::Accepted: cout << "      queued\n"; break;
+        case AdmitResult::Invalid: cout << "      rejected: invalid transaction\n"; break;
+        case AdmitResult::InsufficientFunds:
+            cout << "      rejected: " << from << " cannot cover it (balance " << myChain.balances.balance(from)
+                 << " incl. pending spends)\n";
+            break;
+        case AdmitResult::FeeTooLow: cout << "      rejected: mempool full of higher-fee transactions\n"; break;
+        }
+    };
+
     cout << "===== Simple Blockchain Demo =====\n";
-    cout << "Commands: add, tamper, view, validate, quit\n";
+    cout << "Commands: add, send, mine, mempool, balance, tamper, view, validate, prove, quit\n";
     while(true) {
         cout << "\n> ";
         cin >> cmd;
         if(cmd == "add") {
-            vector<Transaction> txs;
             int n;
             cout << "How many transactions in this block? ";
             cin >> n;
-            for(int i=0; i<n; ++i) {
-                string from, to; double amt;
-                cout << "TX#" << i+1 << " from: "; cin >> from;
-                cout << "      to: "; cin >> to;
-                cout << "      amount: "; cin >> amt;
-                txs.emplace_back(from, to, amt);
-            }
-            myChain.addBlock(txs);
-            cout << "Block added!\n";
+            for(int i=0; i<n; ++i) submit("TX#" + to_string(i + 1));
+            if (myChain.mineFromMempool(mempool, blockTxs, miner)) cout << "Block added!\n";
+        } else if (cmd == "send") {
+            submit("TX");
+        } else if (cmd == "mine") {
+            if (myChain.mineFromMempool(mempool, blockTxs, miner)) cout << "Block added!\n";
+        } else if (cmd == "mempool") {
+            mempool.print();
+        } else if (cmd == "balance") {
+            string account;
+            cout << "Account: "; cin >> account;
+            cout << account << ": " << myChain.balances.balance(account) << "\n";
         } else if (cmd == "view") {
             myChain.print();
         } else if (cmd == "validate") {
@@ -159,7 +1079,23 @@ int main() {
                 if (!myChain.chain[idx].txs.empty())
                     myChain.chain[idx].txs[0].amount = 99999;
                 myChain.chain[idx].hash = myChain.chain[idx].calcHash();
+                myChain.markModified(idx);
+            }
+        } else if (cmd == "prove") {
+            size_t b, t;
+            cout << "Block index: "; cin >> b;
+            cout << "TX# (from 1): "; cin >> t;
+            if (b >= myChain.chain.size() || t < 1 || t > myChain.chain[b].txs.size()) {
+                cout << "No such transaction.\n";
+                continue;
             }
+            const Block& blk = myChain.chain[b];
+            MerkleProof proof = blk.proveTransaction(t - 1);
+            for (const auto& step : proof)
+                cout << "  " << (step.siblingOnLeft ? "L " : "R ") << toHex(step.sibling) << "\n";
+            bool ok = MerkleTree::verify(MerkleTree::leafHash(blk.txs[t - 1]), proof, blk.merkleRoot);
+            cout << proof.size() << "-step proof " << (ok ? "verifies" : "does NOT verify")
+                 << " against block #" << b << "'s Merkle root.\n";
         } else if (cmd == "quit") break;
         else cout << "Unknown command.\n";
     }